@@ -1,8 +1,17 @@
 #include "AssetProvider.h"
+#include "JobSystem.h"
+#include <atomic>
 
 namespace {
    QtHasher<QVariant> hasher = {};
-   uint64_t ID = 1;
+   // shared by all providers, staging ones fill up on other threads
+   std::atomic<uint64_t> ID = 1;
+
+   /// Ids read from a file are kept, new ones are taken after them
+   void reserveId(uint64_t id) {
+      auto next = ID.load();
+      while (next <= id && !ID.compare_exchange_weak(next, id + 1)) {}
+   }
 
    QByteArray variantToByteArray(const QVariant& variant) {
       QByteArray arr;
@@ -30,6 +39,57 @@ namespace {
    QVariant stringToVariant(const QString& json) {
       return byteArrayToVariant(QByteArray::fromBase64(json.toUtf8()));
    }
+
+   enum BinaryAssetKind : quint8 { VariantAsset, ImageAsset };
+
+   /// Whether the layout read from a file describes an image whose rows fit into size bytes
+   bool validImage(qint32 width, qint32 height, qint64 bytesPerLine, qint32 format,
+                   uint64_t size) {
+      if (width <= 0 || height <= 0 || bytesPerLine <= 0 || format <= QImage::Format_Invalid ||
+          format >= QImage::NImageFormats) {
+         return false;
+      }
+      const auto depth = QImage::toPixelFormat(QImage::Format(format)).bitsPerPixel();
+      return uint64_t(width) * depth <= uint64_t(bytesPerLine) * 8 &&
+             size >= uint64_t(bytesPerLine) * uint64_t(height);
+   }
+
+   QImage mappedImage(const BinaryReader& reader, const BlobRef& pixels, qint32 width,
+                      qint32 height, qint64 bytesPerLine, qint32 format) {
+      const auto* data = reader.blob(pixels);
+      if (!data || !validImage(width, height, bytesPerLine, format, pixels.size)) return {};
+
+      // the image keeps the mapping alive until its pixels are released
+      auto* owner = new sptr<const void>(reader.owner());
+      return QImage(data, width, height, bytesPerLine, QImage::Format(format),
+                    [](void* info) { delete static_cast<sptr<const void>*>(info); }, owner);
+   }
+
+   /// Decompresses the pixels once the image is needed
+   std::function<QVariant()> compressedImage(const BinaryReader& reader, const BlobRef& pixels,
+                                             qint32 width, qint32 height, qint64 bytesPerLine,
+                                             qint32 format) {
+      // the decompressed size is checked against the stored blocks, the rows have to match it
+      // exactly since they are allocated before anything is decompressed
+      const auto size = reader.size(pixels);
+      if (!validImage(width, height, bytesPerLine, format, size) ||
+          size != uint64_t(bytesPerLine) * uint64_t(height)) {
+         return {};
+      }
+
+      return [unpack = reader.unpacker(pixels), size, width, height, bytesPerLine, format] {
+         QImage image(width, height, QImage::Format(format));
+         if (image.isNull()) return QVariant();
+         if (image.bytesPerLine() == bytesPerLine && uint64_t(image.sizeInBytes()) == size) {
+            return unpack(image.bits()) ? QVariant::fromValue(image) : QVariant();
+         }
+         // rows were padded differently by the writer
+         std::vector<uchar> data(size);
+         if (!unpack(data.data())) return QVariant();
+         return QVariant::fromValue(QImage(data.data(), width, height, bytesPerLine,
+                                           QImage::Format(format)).copy());
+      };
+   }
 }
 
 AssetProvider& AssetProvider::instance() {
@@ -37,43 +97,387 @@ AssetProvider& AssetProvider::instance() {
    return inst;
 }
 
+uptr<AssetProvider> AssetProvider::createStaging() {
+   return uptr<AssetProvider>(new AssetProvider());
+}
+
 uint64_t AssetProvider::add(QVariant asset) {
+   std::lock_guard lock(m_mutex);
    if (const auto it = m_assets.find(asset); it != m_assets.end()) {
-      return it->second;
+      return it->second.id;
    }
-   return m_assets.emplace(std::move(asset), ID++).first->second;
+   const auto id = ID++;
+   insert(std::move(asset), id);
+   return id;
 }
 
 const QVariant& AssetProvider::get(uint64_t id) {
-   const auto it = std::ranges::find_if(m_assets, [id](const auto& pair) {
-      return pair.second == id;
-   });
-   if (it == m_assets.end()) {
-      static QVariant empty;
-      return empty;
+   Source source;
+   {
+      std::lock_guard lock(m_mutex);
+      if (const auto it = m_ids.find(id); it != m_ids.end()) return it->second->first;
+      source = this->source(id);
    }
-   return it->first;
+
+   // pending assets are decoded or read from their store when they are needed for the first time
+   auto asset = source.load();
+   std::lock_guard lock(m_mutex);
+   // another thread may have needed it meanwhile
+   if (const auto it = m_ids.find(id); it != m_ids.end()) return it->second->first;
+   if (asset.isValid()) return insert(std::move(asset), id);
+   dropPending(id);
+
+   static QVariant empty;
+   return empty;
 }
 
 bool AssetProvider::has(uint64_t id) const {
-   return std::ranges::find_if(m_assets, [id](const auto& pair) {
-      return pair.second == id;
-   }) != m_assets.end();
+   std::lock_guard lock(m_mutex);
+   return m_ids.contains(id) || m_encoded.contains(id) || m_stored.contains(id) ||
+          m_compressed.contains(id);
+}
+
+void AssetProvider::loadPending() {
+   std::vector<uint64_t> pending;
+   std::vector<Source> sources;
+   {
+      std::lock_guard lock(m_mutex);
+      for (const auto& [id, _]: m_encoded) pending.push_back(id);
+      for (const auto& [id, _]: m_compressed) pending.push_back(id);
+      for (const auto& [id, _]: m_stored) {
+         if (!m_ids.contains(id)) pending.push_back(id);
+      }
+      for (const auto id: pending) sources.push_back(source(id));
+   }
+
+   // decoding and reading the files is the expensive part, it runs in parallel
+   std::vector<QVariant> assets(pending.size());
+   JobSystem::instance().parallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) assets[i] = sources[i].load();
+   });
+
+   std::lock_guard lock(m_mutex);
+   for (size_t i = 0; i < assets.size(); ++i) {
+      if (m_ids.contains(pending[i])) continue;
+      if (assets[i].isValid()) insert(std::move(assets[i]), pending[i]);
+      else dropPending(pending[i]);
+   }
+}
+
+void AssetProvider::merge(AssetProvider& staged) {
+   std::scoped_lock lock(m_mutex, staged.m_mutex);
+   for (const auto id: staged.ids()) {
+      auto source = staged.source(id);
+      forget(id);
+      m_encoded.erase(id);
+      m_compressed.erase(id);
+      m_stored.erase(id);
+      reserveId(id);
+      if (source.asset.isValid()) insert(std::move(source.asset), id);
+      else if (!source.encoded.isEmpty()) m_encoded[id] = std::move(source.encoded);
+      else if (source.compressed) m_compressed[id] = std::move(source.compressed);
+      if (source.stored.store) m_stored[id] = std::move(source.stored);
+      m_staleBuffers.push_back(id);
+   }
+
+   staged.m_ids.clear();
+   staged.m_assets.clear();
+   staged.m_encoded.clear();
+   staged.m_compressed.clear();
+   staged.m_stored.clear();
+}
+
+void AssetProvider::dropStaleBuffers() {
+   std::vector<uint64_t> stale;
+   {
+      std::lock_guard lock(m_mutex);
+      if (m_staleBuffers.empty()) return;
+      stale.swap(m_staleBuffers);
+   }
+   for (const auto id: stale) m_buffers.erase(id);
 }
 
 QJsonObject AssetProvider::toJson() const {
-   QJsonObject result;
-   for (const auto& [asset, id]: m_assets) {
-      result[QString::number(id)] = variantToString(asset);
+   std::vector<uint64_t> ids;
+   std::vector<Source> sources;
+   {
+      std::lock_guard lock(m_mutex);
+      ids = this->ids();
+      for (const auto id: ids) sources.push_back(source(id));
    }
+
+   // encoding the assets is the expensive part, it runs in parallel
+   std::vector<QString> encoded(ids.size());
+   JobSystem::instance().parallelFor(ids.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) encoded[i] = sources[i].encode();
+   });
+
+   QJsonObject result;
+   for (size_t i = 0; i < ids.size(); ++i) result[QString::number(ids[i])] = encoded[i];
    return result;
 }
 
-void AssetProvider::fromJson(const QJsonObject& json) {
-   for (const auto& key: json.keys()) {
-      auto id = key.toULongLong();
-      if (id >= ID) ID = id + 1;
-      m_assets.emplace(stringToVariant(json[key].toString()), id);
+void AssetProvider::fromJson(const QJsonObject& json, const sptr<AssetStore>& store) {
+   std::lock_guard lock(m_mutex);
+   for (auto it = json.begin(); it != json.end(); ++it) {
+      const auto id = it.key().toULongLong();
+      if (it.value().isObject()) addStored(id, store, it.value().toObject()["store"].toString());
+      else addEncoded(id, it.value().toString());
+   }
+}
+
+void AssetProvider::write(JsonStreamWriter& writer, const sptr<AssetStore>& store) {
+   write(writer, store, ids());
+}
+
+void AssetProvider::write(JsonStreamWriter& writer, const sptr<AssetStore>& store,
+                          std::span<const uint64_t> ids) {
+   // a window of assets is encoded or put into the store in parallel, then written in order
+   auto& jobs = JobSystem::instance();
+   const auto window = std::max<size_t>(jobs.workerCount(), 1);
+
+   writer.beginObject();
+   std::vector<QString> keys, encoded;
+   std::vector<Source> sources;
+   std::vector<size_t> unique, source;
+   for (size_t first = 0; first < ids.size(); first += window) {
+      const auto count = std::min(window, ids.size() - first);
+      keys.assign(count, {});
+      encoded.assign(count, {});
+      sources.clear();
+      unique.clear();
+      source.resize(count);
+      {
+         // only locked to copy the window, so the GUI can get at the assets meanwhile
+         std::lock_guard lock(m_mutex);
+         // ids sharing an asset would race to write the same file, only the first one stores it
+         std::map<std::pair<const void*, QString>, size_t> seen;
+         for (size_t i = 0; i < count; ++i) {
+            sources.push_back(this->source(ids[first + i]));
+            const auto [it, added] = seen.emplace(identity(ids[first + i]), i);
+            source[i] = it->second;
+            if (added) unique.push_back(i);
+         }
+      }
+
+      jobs.parallelFor(unique.size(), 1, [&](size_t begin, size_t end) {
+         for (size_t k = begin; k < end; ++k) {
+            const auto i = unique[k];
+            if (store) keys[i] = sources[i].storedKey(*store);
+            // assets the store can't take are embedded
+            if (keys[i].isEmpty()) encoded[i] = sources[i].encode();
+         }
+      });
+
+      for (size_t i = 0; i < count; ++i) {
+         keys[i] = keys[source[i]];
+         encoded[i] = encoded[source[i]];
+         writer.key(QString::number(ids[first + i]));
+         if (keys[i].isEmpty()) writer.value(encoded[i]);
+         else writer.value(QJsonObject{{"store", keys[i]}});
+      }
+
+      // the written file is where the assets are copied from the next time
+      std::lock_guard lock(m_mutex);
+      for (size_t i = 0; i < count; ++i) {
+         if (!keys[i].isEmpty()) m_stored[ids[first + i]] = {store, keys[i]};
+      }
+   }
+   writer.endObject();
+}
+
+void AssetProvider::read(JsonStreamReader& reader, const sptr<AssetStore>& store) {
+   if (!reader.enterObject()) return;
+   QString key;
+   while (reader.nextKey(key)) {
+      const auto id = key.toULongLong();
+      const auto value = reader.readValue();
+      std::lock_guard lock(m_mutex);
+      if (value.isObject()) addStored(id, store, value.toObject()["store"].toString());
+      else addEncoded(id, value.toString());
+   }
+}
+
+void AssetProvider::addEncoded(uint64_t id, QString encoded) {
+   // an asset loaded before under the same id is replaced once this one is needed
+   reserveId(id);
+   forget(id);
+   m_stored.erase(id);
+   m_compressed.erase(id);
+   m_encoded[id] = std::move(encoded);
+}
+
+void AssetProvider::addStored(uint64_t id, const sptr<AssetStore>& store, const QString& key) {
+   if (!store || !AssetStore::isKey(key)) {
+      GS_DEBUG() << "Skipping asset" << id << "which references" << key << "without a store";
+      return;
+   }
+   reserveId(id);
+   forget(id);
+   m_encoded.erase(id);
+   m_compressed.erase(id);
+   m_stored[id] = {store, key};
+}
+
+void AssetProvider::addCompressed(uint64_t id, std::function<QVariant()> load) {
+   reserveId(id);
+   forget(id);
+   m_encoded.erase(id);
+   m_stored.erase(id);
+   m_compressed[id] = std::move(load);
+}
+
+const QVariant& AssetProvider::insert(QVariant asset, uint64_t id) {
+   reserveId(id);
+   m_encoded.erase(id);
+   m_compressed.erase(id);
+   forget(id);
+   // an equal asset which is already known is shared by both ids
+   const auto [it, added] = m_assets.try_emplace(std::move(asset), Shared{id});
+   if (!added) ++it->second.refs;
+   m_ids[id] = it;
+   return it->first;
+}
+
+void AssetProvider::forget(uint64_t id) {
+   const auto loaded = m_ids.find(id);
+   if (loaded == m_ids.end()) return;
+   const auto asset = loaded->second;
+   m_ids.erase(loaded);
+   if (--asset->second.refs == 0) {
+      m_assets.erase(asset);
+   } else if (asset->second.id == id) {
+      // add() hands out this id for the asset, it has to be one which still resolves to it
+      for (const auto& [other, shared]: m_ids) {
+         if (shared == asset) {
+            asset->second.id = other;
+            break;
+         }
+      }
+   }
+}
+
+void AssetProvider::dropPending(uint64_t id) {
+   if (m_ids.contains(id)) return;
+   if (m_encoded.erase(id) + m_compressed.erase(id) + m_stored.erase(id) != 0) {
+      GS_DEBUG() << "Dropping asset" << id << "which couldn't be loaded";
+   }
+}
+
+std::vector<uint64_t> AssetProvider::ids() const {
+   std::lock_guard lock(m_mutex);
+   std::vector<uint64_t> ids;
+   ids.reserve(m_ids.size() + m_encoded.size() + m_compressed.size() + m_stored.size());
+   for (const auto& [id, _]: m_ids) ids.push_back(id);
+   for (const auto& [id, _]: m_encoded) ids.push_back(id);
+   for (const auto& [id, _]: m_compressed) ids.push_back(id);
+   for (const auto& [id, _]: m_stored) {
+      if (!m_ids.contains(id)) ids.push_back(id);
+   }
+   std::ranges::sort(ids);
+   return ids;
+}
+
+AssetProvider::Source AssetProvider::source(uint64_t id) const {
+   Source source;
+   if (const auto loaded = m_ids.find(id); loaded != m_ids.end()) {
+      source.asset = loaded->second->first;
+   } else if (const auto encoded = m_encoded.find(id); encoded != m_encoded.end()) {
+      source.encoded = encoded->second;
+   } else if (const auto compressed = m_compressed.find(id); compressed != m_compressed.end()) {
+      source.compressed = compressed->second;
+   }
+   if (const auto stored = m_stored.find(id); stored != m_stored.end()) {
+      source.stored = stored->second;
+   }
+   return source;
+}
+
+QVariant AssetProvider::Source::load() const {
+   if (asset.isValid()) return asset;
+   if (!encoded.isEmpty()) return stringToVariant(encoded);
+   if (compressed) return compressed();
+   if (stored.store) return stored.store->get(stored.key);
+   return {};
+}
+
+QString AssetProvider::Source::encode() const {
+   if (!encoded.isEmpty()) return encoded;
+   return variantToString(load());
+}
+
+std::pair<const void*, QString> AssetProvider::identity(uint64_t id) const {
+   // keys name the content of a file, so equal keys of different stores are the same asset
+   if (const auto stored = m_stored.find(id); stored != m_stored.end()) {
+      return {nullptr, stored->second.key};
+   }
+   if (const auto it = m_ids.find(id); it != m_ids.end()) return {&it->second->first, {}};
+   return {nullptr, QString::number(id)};
+}
+
+QString AssetProvider::Source::storedKey(AssetStore& store) const {
+   if (stored.store) {
+      if (stored.store.get() == &store || store.import(*stored.store, stored.key)) return stored.key;
+   }
+   const auto asset = load();
+   return asset.isValid() ? store.put(asset) : QString();
+}
+
+void AssetProvider::write(BinaryWriter& writer) const {
+   std::vector<uint64_t> ids;
+   std::vector<Source> sources;
+   {
+      std::lock_guard lock(m_mutex);
+      ids = this->ids();
+      for (const auto id: ids) sources.push_back(source(id));
+   }
+
+   // pending assets are loaded one at a time, only the current one is held
+   writer.record() << quint64(ids.size());
+   for (size_t i = 0; i < ids.size(); ++i) {
+      const auto id = ids[i];
+      const auto asset = sources[i].load();
+      writer.record() << quint64(id);
+      if (const auto* image = get_if<QImage>(&asset)) {
+         writer.record() << quint8(ImageAsset) << qint32(image->width()) << qint32(image->height())
+               << qint64(image->bytesPerLine()) << qint32(image->format())
+               << writer.blob(image->constBits(), image->sizeInBytes(),
+                              std::max(image->depth() / 8, 1));
+      } else {
+         writer.record() << quint8(VariantAsset) << asset;
+      }
+   }
+}
+
+void AssetProvider::read(BinaryReader& reader) {
+   std::lock_guard lock(m_mutex);
+   auto& record = reader.record();
+   quint64 count = 0;
+   record >> count;
+   for (quint64 i = 0; i < count && record.status() == QDataStream::Ok; ++i) {
+      quint64 id;
+      quint8 kind;
+      record >> id >> kind;
+
+      QVariant asset;
+      if (kind == ImageAsset) {
+         qint32 width, height, format;
+         qint64 bytesPerLine;
+         BlobRef pixels;
+         record >> width >> height >> bytesPerLine >> format >> pixels;
+         if (pixels.compressed) {
+            if (auto load = compressedImage(reader, pixels, width, height, bytesPerLine, format)) {
+               addCompressed(id, std::move(load));
+            }
+            continue;
+         }
+         asset = QVariant::fromValue(mappedImage(reader, pixels, width, height, bytesPerLine,
+                                                 format));
+      } else {
+         record >> asset;
+      }
+
+      insert(std::move(asset), id);
    }
 }
 
@@ -1,43 +1,130 @@
 #pragma once
 #include "Common.h"
+#include "AssetStore.h"
+#include "Model/Serialization/BinaryArchive.h"
+#include "Model/Serialization/JsonStream.h"
 #include <QJsonObject>
 #include <QUuid>
 #include <QHash>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <unordered_map>
+#include <span>
 #include <QOpenGLTexture>
 
+/// Assets shared by all scenes. Scenes are loaded and saved on worker threads while the GUI keeps
+/// using the provider, so all access to the assets goes through one lock. It is only held to copy
+/// what an asset is loaded from, the decoding, encoding and file access run without it. The GPU
+/// buffers are only touched by the thread which renders, which is still the GUI thread.
 class AssetProvider {
 public:
    static AssetProvider& instance();
+   /// Scenes are loaded into a provider of their own on the worker thread, the scenes using the
+   /// global one don't see any of it until it is merged into the global one
+   static uptr<AssetProvider> createStaging();
 
 public:
    uint64_t add(QVariant asset);
    template<typename T>
    uint64_t add(T asset);
 
+   /// An invalid variant if the asset is unknown or couldn't be loaded. The reference stays valid
+   /// until the id is replaced, e.g. by a merge.
    const QVariant& get(uint64_t id);
+   /// An empty T if the asset is unknown, couldn't be loaded or is no T
    template<typename T> const T& get(uint64_t id);
 
    template <typename T> void prepare(uint64_t id);
    template <typename T> void bind(uint64_t id, int unit = 0);
    template <typename T> void unbind(uint64_t id);
 
+   /// Pending assets count until loading them fails, from then on they are dropped
    bool has(uint64_t id) const;
+   /// Ids of the loaded and the pending assets, sorted
+   std::vector<uint64_t> ids() const;
+   /// Decodes or reads all pending assets at once instead of on first use
+   void loadPending();
+   /// Takes over the loaded and the pending assets of staged, replacing the ones with the same ids
+   void merge(AssetProvider& staged);
 
+   /// Assets are embedded as base64, references into a store are only read with one.
+   /// Either way they are pending until they are first needed.
    QJsonObject toJson() const;
-   void fromJson(const QJsonObject& json);
+   void fromJson(const QJsonObject& json, const sptr<AssetStore>& store = nullptr);
+   /// Same layout as toJson, only a window of encoded assets is held at a time. With a store the
+   /// assets are put into it and only referenced by their key, reading them is then deferred
+   /// until they are first needed.
+   void write(JsonStreamWriter& writer, const sptr<AssetStore>& store = nullptr);
+   /// Only writes the given assets
+   void write(JsonStreamWriter& writer, const sptr<AssetStore>& store,
+              std::span<const uint64_t> ids);
+   void read(JsonStreamReader& reader, const sptr<AssetStore>& store = nullptr);
+   /// Images are stored as raw pixels and view the mapped file after loading, compressed ones
+   /// are pending until they are first needed
+   void write(BinaryWriter& writer) const;
+   void read(BinaryReader& reader);
+
+private:
+   /// Where the assets of a store can be read from, the ones not in m_ids are still pending
+   struct StoredAsset {
+      sptr<AssetStore> store;
+      QString key;
+   };
+
+   /// Everything an asset can be loaded from, copied under the lock
+   struct Source {
+      QVariant asset;
+      QString encoded;
+      std::function<QVariant()> compressed;
+      StoredAsset stored;
+
+      /// The asset, decoded or read if it is still pending
+      QVariant load() const;
+      /// Base64 form of the asset, pending ones aren't decoded for it
+      QString encode() const;
+      /// Assets which came from a store are copied over as files, only new ones are hashed
+      QString storedKey(AssetStore& store) const;
+   };
 
 private:
    AssetProvider() = default;
+   void addEncoded(uint64_t id, QString encoded);
+   void addStored(uint64_t id, const sptr<AssetStore>& store, const QString& key);
+   void addCompressed(uint64_t id, std::function<QVariant()> load);
+   const QVariant& insert(QVariant asset, uint64_t id);
+   /// Drops the loaded asset of id, it is only erased once no other id shares it
+   void forget(uint64_t id);
+   void dropPending(uint64_t id);
+   /// Textures of assets replaced by a merge, dropped by the thread which renders
+   void dropStaleBuffers();
+   Source source(uint64_t id) const;
+   /// Equal for ids which share their asset or their stored file, so those are only stored once
+   std::pair<const void*, QString> identity(uint64_t id) const;
 
 private:
    struct QVariantComparator {
       bool operator()(const QVariant& lhs, const QVariant& rhs) const;
    };
 
-   std::map<QVariant, uint64_t, QVariantComparator> m_assets;
+   /// The id add() returns for the asset and how many ids share it
+   struct Shared {
+      uint64_t id;
+      size_t refs = 1;
+   };
+
+   using Assets = std::map<QVariant, Shared, QVariantComparator>;
+   Assets m_assets;
+   std::unordered_map<uint64_t, Assets::iterator> m_ids;
+   std::unordered_map<uint64_t, StoredAsset> m_stored;
+   /// Embedded assets which haven't been decoded yet
+   std::unordered_map<uint64_t, QString> m_encoded;
+   /// Assets of binary scenes which haven't been decompressed yet
+   std::unordered_map<uint64_t, std::function<QVariant()>> m_compressed;
    std::map<uint64_t, sptr<void>> m_buffers;
+   std::vector<uint64_t> m_staleBuffers;
+   mutable std::recursive_mutex m_mutex;
 };
 
 template<typename T>
@@ -47,15 +134,18 @@ uint64_t AssetProvider::add(T asset) {
 
 template<typename T>
 const T& AssetProvider::get(uint64_t id) {
-   auto& variant = get(id);
-   auto& asset = *get_if<T>(&variant);
-   return asset;
+   static const T empty;
+   const auto* asset = get_if<T>(&get(id));
+   return asset ? *asset : empty;
 }
 
 template<>
 inline void AssetProvider::prepare<QImage>(uint64_t id) {
+   dropStaleBuffers();
    if (m_buffers.contains(id)) return;
    const auto& image = get<QImage>(id);
+   // missing images are left unbound
+   if (image.isNull()) return;
    auto buffer = std::make_shared<QOpenGLTexture>(image.mirrored());
    buffer->setMinificationFilter(QOpenGLTexture::Linear);
    buffer->setMagnificationFilter(QOpenGLTexture::Linear);
@@ -0,0 +1,154 @@
+#include "AssetStore.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QUuid>
+#include <map>
+#include <mutex>
+
+namespace {
+   constexpr auto ImageSuffix = ".png";
+   constexpr auto VariantSuffix = ".variant";
+   // PNG can't hold every format, the original one is kept as text and restored after loading
+   constexpr auto FormatText = "QImageFormat";
+
+   std::mutex s_storesMutex;
+   std::map<QString, wptr<AssetStore>> s_stores;
+
+   /// Images are hashed by their pixels instead of their PNG form, so saving an image that is
+   /// already stored skips the encoding
+   QByteArray imageHash(const QImage& image) {
+      QCryptographicHash hash(QCryptographicHash::Sha256);
+      QByteArray header;
+      QDataStream stream(&header, QIODevice::WriteOnly);
+      stream << qint32(image.width()) << qint32(image.height()) << qint32(image.format());
+      // indexed images with the same indices but different palettes are different images
+      if (!image.colorTable().isEmpty()) stream << image.colorTable();
+      hash.addData(header);
+      const auto lineSize = (qsizetype(image.width()) * image.depth() + 7) / 8;
+      for (int y = 0; y < image.height(); ++y) {
+         const auto* line = reinterpret_cast<const char*>(image.constScanLine(y));
+         hash.addData(QByteArrayView(line, lineSize));
+      }
+      return hash.result().toHex();
+   }
+
+   QByteArray variantBytes(const QVariant& variant) {
+      QByteArray bytes;
+      QDataStream stream(&bytes, QIODevice::WriteOnly);
+      stream << variant;
+      return bytes;
+   }
+}
+
+sptr<AssetStore> AssetStore::open(const QString& directory) {
+   const auto canonical = QDir::cleanPath(QFileInfo(directory).absoluteFilePath());
+   std::lock_guard lock(s_storesMutex);
+   auto& entry = s_stores[canonical];
+   if (auto store = entry.lock()) return store;
+
+   sptr<AssetStore> store(new AssetStore(canonical));
+   entry = store;
+   return store;
+}
+
+sptr<AssetStore> AssetStore::forScene(const QString& scenePath) {
+   return open(QFileInfo(scenePath).absoluteDir().filePath(u"assets"_s));
+}
+
+AssetStore::AssetStore(QString directory) : m_directory(std::move(directory)) {}
+
+QString AssetStore::put(const QVariant& asset) {
+   const auto* image = get_if<QImage>(&asset);
+   QByteArray bytes;
+   QString key;
+   if (image) {
+      key = QString::fromLatin1(imageHash(*image)) + ImageSuffix;
+   } else {
+      bytes = variantBytes(asset);
+      key = QString::fromLatin1(QCryptographicHash::hash(bytes, QCryptographicHash::Sha256).toHex())
+            + VariantSuffix;
+   }
+   if (contains(key)) return key;
+
+   // written to a temporary file first, readers never see half of an asset
+   QDir().mkpath(m_directory);
+   QSaveFile file(path(key));
+   if (!file.open(QIODevice::WriteOnly)) {
+      GS_DEBUG() << "Couldn't write asset" << file.fileName();
+      return {};
+   }
+   bool written;
+   if (image) {
+      QImageWriter writer(&file, "PNG");
+      writer.setText(FormatText, QString::number(image->format()));
+      written = writer.write(*image);
+   } else {
+      written = file.write(bytes) == bytes.size();
+   }
+   if (!written || !file.commit()) {
+      GS_DEBUG() << "Couldn't write asset" << file.fileName();
+      return {};
+   }
+   return key;
+}
+
+QVariant AssetStore::get(const QString& key) const {
+   if (!isKey(key)) return {};
+
+   if (key.endsWith(ImageSuffix)) {
+      QImage image;
+      if (!QImageReader(path(key), "PNG").read(&image)) {
+         GS_DEBUG() << "Couldn't read asset" << path(key);
+         return {};
+      }
+      bool ok;
+      const auto format = image.text(FormatText).toInt(&ok);
+      if (ok && format > QImage::Format_Invalid && format < QImage::NImageFormats &&
+          format != image.format()) {
+         image.convertTo(QImage::Format(format));
+      }
+      return QVariant::fromValue(std::move(image));
+   }
+
+   QFile file(path(key));
+   if (!file.open(QIODevice::ReadOnly)) {
+      GS_DEBUG() << "Couldn't read asset" << path(key);
+      return {};
+   }
+   QVariant variant;
+   QDataStream stream(&file);
+   stream >> variant;
+   return variant;
+}
+
+bool AssetStore::contains(const QString& key) const {
+   return isKey(key) && QFile::exists(path(key));
+}
+
+bool AssetStore::import(const AssetStore& other, const QString& key) {
+   if (contains(key)) return true;
+   if (!other.contains(key)) return false;
+   QDir().mkpath(m_directory);
+   // copied under a temporary name of its own and renamed, so concurrent imports of the same
+   // key neither see a partial file nor write into each other's copy
+   const auto temporary = path(key) + u'.' + QUuid::createUuid().toString(QUuid::Id128) +
+                          u".part"_s;
+   if (!QFile::copy(other.path(key), temporary)) return false;
+   if (QFile::rename(temporary, path(key))) return true;
+   // another import got there first
+   QFile::remove(temporary);
+   return contains(key);
+}
+
+bool AssetStore::isKey(const QString& key) {
+   static const QRegularExpression pattern(u"^[0-9a-f]{64}\\.(png|variant)$"_s);
+   return pattern.match(key).hasMatch();
+}
+
+QString AssetStore::path(const QString& key) const { return m_directory + u'/' + key; }
@@ -0,0 +1,33 @@
+#pragma once
+#include "Common.h"
+#include <QString>
+#include <QVariant>
+
+/// Directory of assets named by the SHA-256 of their content. Every asset is written once, images
+/// as PNG and everything else as its QDataStream form, and scenes only reference the file names.
+/// There is one instance per directory, so all scenes using a directory share its store.
+class AssetStore {
+public:
+   static sptr<AssetStore> open(const QString& directory);
+   /// The store shared by all scenes in the directory of scenePath
+   static sptr<AssetStore> forScene(const QString& scenePath);
+
+   const QString& directory() const { return m_directory; }
+
+   /// Writes the asset unless the store already has it and returns its key, empty on failure
+   QString put(const QVariant& asset);
+   QVariant get(const QString& key) const;
+   bool contains(const QString& key) const;
+   /// Copies the file of key from another store unless this one already has it
+   bool import(const AssetStore& other, const QString& key);
+
+   /// Whether key names an asset file, keys come from scene files and are checked before use
+   static bool isKey(const QString& key);
+
+private:
+   explicit AssetStore(QString directory);
+   QString path(const QString& key) const;
+
+private:
+   QString m_directory;
+};
@@ -0,0 +1,136 @@
+#include "JobSystem.h"
+#include <limits>
+#include <utility>
+
+namespace {
+   /// The pool the current thread is a worker of and the index of its queue there
+   struct Worker {
+      const JobSystem* pool = nullptr;
+      size_t queue = std::numeric_limits<size_t>::max();
+   };
+   thread_local Worker CURRENT_WORKER;
+}
+
+JobSystem& JobSystem::instance() {
+   // the main thread takes part in every wait, so it doesn't need a worker of its own
+   static JobSystem instance(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+   return instance;
+}
+
+JobSystem::JobSystem(size_t workers) {
+   for (size_t i = 0; i <= workers; ++i) m_queues.push_back(std::make_unique<Queue>());
+   m_threads.reserve(workers);
+   for (size_t i = 0; i < workers; ++i) m_threads.emplace_back([this, i] { work(i); });
+}
+
+JobSystem::~JobSystem() {
+   {
+      std::lock_guard lock(m_sleepMutex);
+      m_stop = true;
+   }
+   m_wake.notify_all();
+   for (auto& thread: m_threads) thread.join();
+}
+
+size_t JobSystem::workerCount() const {
+   return m_threads.size();
+}
+
+void JobSystem::submit(Job job, JobCounter& counter) {
+   counter.pending.fetch_add(1, std::memory_order_relaxed);
+   auto done = [job = std::move(job), &counter] {
+      // a throwing job still finishes, otherwise its batch would be waited for forever
+      try {
+         job();
+      } catch (...) {
+         std::lock_guard lock(counter.mutex);
+         if (!counter.error) counter.error = std::current_exception();
+      }
+      counter.pending.fetch_sub(1, std::memory_order_release);
+   };
+
+   // counted before it can be popped, so the count never drops below zero
+   m_queued.fetch_add(1, std::memory_order_release);
+   const auto index = currentQueue();
+   {
+      std::lock_guard lock(m_queues[index]->mutex);
+      m_queues[index]->jobs.push_back({std::move(done), &counter});
+   }
+
+   // taking the lock makes sure a worker can't miss the wake up between checking and sleeping
+   { std::lock_guard lock(m_sleepMutex); }
+   m_wake.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter) {
+   const auto index = currentQueue();
+   // a thread outside the pool must not end up running the jobs of another one, the GUI thread
+   // would stall on a save which happens to share the queue
+   const bool worker = index != m_queues.size() - 1;
+   while (counter.pending.load(std::memory_order_acquire) != 0) {
+      if (!(worker ? runOne(index) : runOwn(counter))) std::this_thread::yield();
+   }
+
+   std::lock_guard lock(counter.mutex);
+   if (counter.error) std::rethrow_exception(std::exchange(counter.error, nullptr));
+}
+
+size_t JobSystem::currentQueue() const {
+   // workers of other pools are outside threads here, they must not take over a worker's queue
+   return CURRENT_WORKER.pool == this ? CURRENT_WORKER.queue : m_queues.size() - 1;
+}
+
+void JobSystem::work(size_t index) {
+   CURRENT_WORKER = {this, index};
+   while (true) {
+      if (runOne(index)) continue;
+
+      std::unique_lock lock(m_sleepMutex);
+      m_wake.wait(lock, [this] { return m_stop || m_queued.load(std::memory_order_acquire) != 0; });
+      if (m_stop) return;
+   }
+}
+
+bool JobSystem::runOne(size_t index) {
+   Job job;
+   // own work is taken newest first while it's still hot, everything else is stolen oldest first
+   bool found = pop(*m_queues[index], job, index != m_queues.size() - 1);
+   for (size_t i = 1; !found && i < m_queues.size(); ++i) {
+      found = pop(*m_queues[(index + i) % m_queues.size()], job, false);
+   }
+   if (!found) return false;
+
+   m_queued.fetch_sub(1, std::memory_order_relaxed);
+   job();
+   return true;
+}
+
+bool JobSystem::runOwn(const JobCounter& counter) {
+   // the batch was pushed last, so its jobs are at the back unless another thread pushed after
+   // it, those are then left to the workers
+   auto& queue = *m_queues.back();
+   Job job;
+   {
+      std::lock_guard lock(queue.mutex);
+      if (queue.jobs.empty() || queue.jobs.back().counter != &counter) return false;
+      job = std::move(queue.jobs.back().job);
+      queue.jobs.pop_back();
+   }
+
+   m_queued.fetch_sub(1, std::memory_order_relaxed);
+   job();
+   return true;
+}
+
+bool JobSystem::pop(Queue& queue, Job& job, bool back) {
+   std::lock_guard lock(queue.mutex);
+   if (queue.jobs.empty()) return false;
+   if (back) {
+      job = std::move(queue.jobs.back().job);
+      queue.jobs.pop_back();
+   } else {
+      job = std::move(queue.jobs.front().job);
+      queue.jobs.pop_front();
+   }
+   return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "Common.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Counts the jobs of one batch which have not finished yet. The first exception thrown by one
+/// of them is kept and rethrown by JobSystem::wait.
+struct JobCounter {
+   std::atomic<size_t> pending = 0;
+   std::mutex mutex;
+   std::exception_ptr error;
+};
+
+/// Work-stealing thread pool. Every worker owns a queue, jobs submitted from a worker go to its
+/// own queue and idle workers steal from the others. Jobs submitted from any other thread go to
+/// a shared queue. Waiting for a batch never blocks, the waiting thread runs jobs meanwhile:
+/// workers run any job, other threads only the jobs of the batch they wait for.
+class JobSystem {
+public:
+   using Job = std::function<void()>;
+
+   static JobSystem& instance();
+
+   explicit JobSystem(size_t workers);
+   ~JobSystem();
+
+   JobSystem(const JobSystem&) = delete;
+   JobSystem& operator=(const JobSystem&) = delete;
+
+   size_t workerCount() const;
+
+   void submit(Job job, JobCounter& counter);
+   /// Runs jobs until the batch is done, then rethrows the first exception of the batch
+   void wait(JobCounter& counter);
+
+   /// Splits [0, count) into chunks of at most grain elements and calls body(begin, end) for each.
+   /// Returns once all chunks are done, rethrowing the first exception one of them threw.
+   template <typename F>
+   void parallelFor(size_t count, size_t grain, F&& body);
+
+private:
+   struct Entry {
+      Job job;
+      const JobCounter* counter;
+   };
+
+   struct Queue {
+      std::mutex mutex;
+      std::deque<Entry> jobs;
+   };
+
+   /// Own queue of a worker of this pool, the shared one for every other thread
+   size_t currentQueue() const;
+   void work(size_t index);
+   bool runOne(size_t index);
+   bool runOwn(const JobCounter& counter);
+   bool pop(Queue& queue, Job& job, bool back);
+
+private:
+   // one queue per worker, the last one is shared by all other threads
+   std::vector<uptr<Queue> > m_queues;
+   std::vector<std::thread> m_threads;
+   std::atomic<size_t> m_queued = 0;
+   std::atomic<bool> m_stop = false;
+   std::mutex m_sleepMutex;
+   std::condition_variable m_wake;
+};
+
+template <typename F>
+void JobSystem::parallelFor(size_t count, size_t grain, F&& body) {
+   grain = std::max<size_t>(grain, 1);
+   if (count <= grain || m_threads.empty()) {
+      if (count != 0) body(size_t(0), count);
+      return;
+   }
+
+   // the calling thread takes the first chunk itself
+   JobCounter counter;
+   for (size_t begin = grain; begin < count; begin += grain) {
+      const auto end = std::min(count, begin + grain);
+      submit([&body, begin, end] { body(begin, end); }, counter);
+   }
+   // the jobs reference body and counter, so they have to finish before anything is thrown
+   std::exception_ptr error;
+   try {
+      body(size_t(0), grain);
+   } catch (...) {
+      error = std::current_exception();
+   }
+   wait(counter);
+   if (error) std::rethrow_exception(error);
+}
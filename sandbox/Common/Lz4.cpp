@@ -0,0 +1,165 @@
+#include "Lz4.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+   constexpr size_t MinMatch = 4;
+   // the format requires the last 5 bytes to be literals and the last match to start 12 bytes
+   // before the end
+   constexpr size_t LastLiterals = 5;
+   constexpr size_t MatchLimit = 12;
+   constexpr size_t MaxOffset = 65535;
+   constexpr int HashLog = 16;
+
+   uint32_t read32(const uint8_t* data) {
+      uint32_t value;
+      std::memcpy(&value, data, sizeof(value));
+      return value;
+   }
+
+   uint32_t hash(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - HashLog); }
+
+   /// Bounds checked output of the compressor
+   struct Output {
+      uint8_t* pos;
+      uint8_t* end;
+      bool ok = true;
+
+      void byte(uint8_t value) {
+         if (pos == end) ok = false;
+         else *pos++ = value;
+      }
+
+      void length(size_t value) {
+         for (; value >= 255; value -= 255) byte(255);
+         byte(uint8_t(value));
+      }
+
+      void bytes(const uint8_t* data, size_t size) {
+         if (size_t(end - pos) < size) {
+            ok = false;
+            return;
+         }
+         if (size == 0) return;
+         std::memcpy(pos, data, size);
+         pos += size;
+      }
+   };
+
+   void sequence(Output& out, const uint8_t* literals, size_t literalCount, size_t offset,
+                 size_t matchLength) {
+      const auto matchCode = matchLength - MinMatch;
+      const auto token = (std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15);
+      out.byte(uint8_t(token));
+      if (literalCount >= 15) out.length(literalCount - 15);
+      out.bytes(literals, literalCount);
+      out.byte(uint8_t(offset));
+      out.byte(uint8_t(offset >> 8));
+      if (matchCode >= 15) out.length(matchCode - 15);
+   }
+
+   void lastLiterals(Output& out, const uint8_t* literals, size_t literalCount) {
+      out.byte(uint8_t(std::min<size_t>(literalCount, 15) << 4));
+      if (literalCount >= 15) out.length(literalCount - 15);
+      out.bytes(literals, literalCount);
+   }
+
+   /// Reads the extension bytes of a length whose token nibble was 15
+   bool extend(const uint8_t*& pos, const uint8_t* end, size_t& length) {
+      uint8_t next;
+      do {
+         if (pos == end) return false;
+         next = *pos++;
+         length += next;
+      } while (next == 255);
+      return true;
+   }
+}
+
+size_t Lz4::compress(const void* src, size_t size, void* dst, size_t capacity) {
+   const auto* begin = static_cast<const uint8_t*>(src);
+   const auto* end = begin + size;
+   const auto* anchor = begin;
+   Output out{static_cast<uint8_t*>(dst), static_cast<uint8_t*>(dst) + capacity};
+
+   if (size > MatchLimit) {
+      // positions of the last sequence seen per hash, candidates are verified before use. Kept
+      // per thread, allocating it for every block took longer than compressing small ones.
+      thread_local std::vector<uint32_t> table(size_t(1) << HashLog);
+      std::ranges::fill(table, 0);
+      const auto* matchStart = end - MatchLimit;
+      const auto* matchEnd = end - LastLiterals;
+      const auto* pos = begin + 1;
+      size_t misses = 0;
+      while (pos <= matchStart && out.ok) {
+         auto& slot = table[hash(read32(pos))];
+         const auto* candidate = begin + slot;
+         slot = uint32_t(pos - begin);
+         if (candidate >= pos || size_t(pos - candidate) > MaxOffset ||
+             read32(candidate) != read32(pos)) {
+            // incompressible data is skipped faster the longer nothing matched
+            pos += 1 + (misses++ >> 6);
+            continue;
+         }
+         misses = 0;
+
+         while (pos > anchor && candidate > begin && pos[-1] == candidate[-1]) {
+            --pos;
+            --candidate;
+         }
+         auto length = MinMatch;
+         while (pos + length < matchEnd && pos[length] == candidate[length]) ++length;
+
+         sequence(out, anchor, size_t(pos - anchor), size_t(pos - candidate), length);
+         pos += length;
+         anchor = pos;
+      }
+   }
+
+   lastLiterals(out, anchor, size_t(end - anchor));
+   return out.ok ? size_t(out.pos - static_cast<uint8_t*>(dst)) : 0;
+}
+
+bool Lz4::decompress(const void* src, size_t srcSize, void* dst, size_t size) {
+   const auto* in = static_cast<const uint8_t*>(src);
+   const auto* inEnd = in + srcSize;
+   auto* out = static_cast<uint8_t*>(dst);
+   auto* const outBegin = out;
+   auto* const outEnd = out + size;
+
+   while (true) {
+      if (in == inEnd) return false;
+      const auto token = *in++;
+
+      size_t literals = token >> 4;
+      if (literals == 15 && !extend(in, inEnd, literals)) return false;
+      if (literals > size_t(inEnd - in) || literals > size_t(outEnd - out)) return false;
+      if (literals != 0) std::memcpy(out, in, literals);
+      in += literals;
+      out += literals;
+      // the last sequence has no match
+      if (in == inEnd) break;
+
+      if (inEnd - in < 2) return false;
+      const size_t offset = in[0] | (size_t(in[1]) << 8);
+      in += 2;
+      if (offset == 0 || offset > size_t(out - outBegin)) return false;
+
+      size_t length = token & 15;
+      if (length == 15 && !extend(in, inEnd, length)) return false;
+      length += MinMatch;
+      if (length > size_t(outEnd - out)) return false;
+
+      // matches may overlap the bytes they produce
+      const auto* match = out - offset;
+      if (offset >= length) {
+         std::memcpy(out, match, length);
+         out += length;
+      } else {
+         for (size_t i = 0; i < length; ++i) *out++ = match[i];
+      }
+   }
+   return out == outEnd;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+/// Codec for the LZ4 block format: sequences of literals followed by a match into the previous
+/// 64 KiB, without the frame format around them. Compression is greedy with a single hash table,
+/// like LZ4's fast mode, decompression checks every length and offset against both buffers.
+struct Lz4 {
+   /// Largest compressed size of size bytes
+   static constexpr size_t bound(size_t size) { return size + size / 255 + 16; }
+   /// No data decompresses to more than this many times its compressed size, every byte of a
+   /// match length adds at most 255 bytes
+   static constexpr size_t MaxRatio = 255;
+
+   /// Size of the compressed data written to dst, 0 if it didn't fit into capacity bytes
+   static size_t compress(const void* src, size_t size, void* dst, size_t capacity);
+
+   /// Whether src decompressed to exactly size bytes, malformed data is rejected
+   static bool decompress(const void* src, size_t srcSize, void* dst, size_t size);
+};
@@ -17,6 +17,10 @@ namespace {
    std::unordered_map<QString, uint64_t> LOADED;
    uint64_t OBJECT_COUNT = 0;
    uint64_t IMAGE_COUNT = 0;
+
+   // objects and parent/child links are collected first and added to the scene in one batch
+   std::vector<uptr<Object> > PENDING_OBJECTS;
+   std::vector<std::pair<QUuid, QUuid> > PENDING_LINKS;
 }
 
 static QUuid importNode(const QDir& root,
@@ -40,6 +44,8 @@ static std::vector<uint64_t> loadMaterialTextures(const QDir& root,
 QUuid AssimpImporter::loadInto(const QString& path, Scene& scene) {
    OBJECT_COUNT = 0;
    IMAGE_COUNT = 0;
+   PENDING_OBJECTS.clear();
+   PENDING_LINKS.clear();
 
    Assimp::Importer importer;
    const auto root = QFileInfo(path).absoluteDir();
@@ -60,6 +66,16 @@ QUuid AssimpImporter::loadInto(const QString& path, Scene& scene) {
    }
 
    auto id = importNode(root, assimpScene->mRootNode, assimpScene, scene, aiMatrix4x4());
+
+   scene.addObjects(std::move(PENDING_OBJECTS));
+   PENDING_OBJECTS.clear();
+   for (const auto& [parentID, childID]: PENDING_LINKS) {
+      auto parentObj = scene.findObject(parentID);
+      auto childObj = scene.findObject(childID);
+      if (parentObj && childObj) { scene.addChild(**parentObj, **childObj); }
+   }
+   PENDING_LINKS.clear();
+
    GS_DEBUG() << "Imported" << OBJECT_COUNT << "objects and " << LOADED.size() << "images";
    return id;
 }
@@ -80,22 +96,14 @@ QUuid importNode(
    for (unsigned int i = 0; i < assimpNode->mNumMeshes; i++) {
       aiMesh* assimpMesh = assimpScene->mMeshes[assimpNode->mMeshes[i]];
       auto id = createObject(root, assimpNode, assimpMesh, assimpScene, scene, nullptr);
-      auto parentObj = scene.findObject(first);
-      auto childObj = scene.findObject(id);
-      if (parentObj && childObj) {
-         scene.addChild(**parentObj, **childObj);
-      }
+      PENDING_LINKS.emplace_back(first, id);
       result.push_back(id);
    }
 
    // process children
    for (unsigned int i = 0; i < assimpNode->mNumChildren; i++) {
       auto child = importNode(root, assimpNode->mChildren[i], assimpScene, scene, globalMatrix);
-      auto parentObj = scene.findObject(first);
-      auto childObj = scene.findObject(child);
-      if (parentObj && childObj) {
-         scene.addChild(**parentObj, **childObj);
-      }
+      PENDING_LINKS.emplace_back(first, child);
    }
    return first;
 }
@@ -188,7 +196,7 @@ QUuid createObject(
    }
 
    const auto id = obj->id();
-   scene.addObject(std::move(obj));
+   PENDING_OBJECTS.push_back(std::move(obj));
    return id;
 }
 
@@ -0,0 +1,124 @@
+#pragma once
+#include "Common/Common.h"
+#include <QUuid>
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+enum class ChangeKind : uint8_t {
+   Added,
+   Removed,
+   Modified
+};
+
+/// Coalesced result of draining a journal. Every id shows up in at most one of the lists:
+/// added ids are new to the consumer, removed ids were known and are gone now and modified ids
+/// were known and changed (or got replaced by a new component).
+struct ChangeSet {
+   std::vector<QUuid> added;
+   std::vector<QUuid> removed;
+   std::vector<QUuid> modified;
+
+   bool empty() const { return added.empty() && removed.empty() && modified.empty(); }
+};
+
+/// Append-only log of changes to one component type. Every consumer subscribes once and
+/// drains everything recorded since its last drain. Entries which all consumers have seen are
+/// trimmed, and nothing is recorded while nobody is subscribed.
+class ChangeJournal {
+public:
+   using Subscription = size_t;
+
+   Subscription subscribe() {
+      for (size_t i = 0; i < m_cursors.size(); ++i) {
+         if (!m_cursors[i]) {
+            m_cursors[i] = end();
+            return i;
+         }
+      }
+      m_cursors.push_back(end());
+      return m_cursors.size() - 1;
+   }
+
+   void unsubscribe(Subscription subscription) {
+      if (subscription >= m_cursors.size()) return;
+      m_cursors[subscription].reset();
+      trim();
+   }
+
+   void record(const QUuid& id, ChangeKind kind) {
+      if (!hasSubscribers()) return;
+      // editors tend to mark the same component over and over again
+      if (kind == ChangeKind::Modified && !m_log.empty() && m_log.back().kind == kind &&
+          m_log.back().id == id) { return; }
+      m_log.push_back({id, kind});
+   }
+
+   ChangeSet drain(Subscription subscription) {
+      ChangeSet result;
+      if (subscription >= m_cursors.size() || !m_cursors[subscription]) return result;
+
+      struct State {
+         ChangeKind first;
+         ChangeKind last;
+      };
+      std::unordered_map<QUuid, State, QtHasher<QUuid> > states;
+      std::vector<QUuid> order;
+
+      for (auto i = *m_cursors[subscription] - m_base; i < m_log.size(); ++i) {
+         const auto& entry = m_log[i];
+         auto [it, inserted] = states.try_emplace(entry.id, State{entry.kind, entry.kind});
+         if (inserted) order.push_back(entry.id);
+         else it->second.last = entry.kind;
+      }
+
+      for (const auto& id: order) {
+         const auto& state = states.at(id);
+         const bool existedBefore = state.first != ChangeKind::Added;
+         const bool existsNow = state.last != ChangeKind::Removed;
+         if (!existedBefore && existsNow) result.added.push_back(id);
+         else if (existedBefore && !existsNow) result.removed.push_back(id);
+         else if (existedBefore && existsNow) result.modified.push_back(id);
+      }
+
+      m_cursors[subscription] = end();
+      trim();
+      return result;
+   }
+
+   /// Whether anything was recorded since the last drain of the subscription
+   bool hasPending(Subscription subscription) const {
+      return subscription < m_cursors.size() && m_cursors[subscription] &&
+             *m_cursors[subscription] < end();
+   }
+
+   bool hasSubscribers() const {
+      return std::ranges::any_of(m_cursors, [](const auto& cursor) { return cursor.has_value(); });
+   }
+
+private:
+   struct Entry {
+      QUuid id;
+      ChangeKind kind;
+   };
+
+   uint64_t end() const { return m_base + m_log.size(); }
+
+   void trim() {
+      std::optional<uint64_t> oldest;
+      for (const auto& cursor: m_cursors) {
+         if (cursor && (!oldest || *cursor < *oldest)) oldest = cursor;
+      }
+      const auto until = oldest.value_or(end());
+      while (m_base < until) {
+         m_log.pop_front();
+         ++m_base;
+      }
+   }
+
+   std::deque<Entry> m_log;
+   uint64_t m_base = 0;
+   std::vector<std::optional<uint64_t> > m_cursors;
+};
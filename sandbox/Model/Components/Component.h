@@ -4,6 +4,10 @@
 #include <QJsonObject>
 #include <QOpenGLShaderProgram>
 #include <QJsonArray>
+#include <limits>
+
+template<typename T>
+struct ComponentsRegistry;
 
 struct Component {
    explicit Component(Object* parent) noexcept : m_parent(parent) {}
@@ -23,13 +27,30 @@ struct Component {
    virtual void bind(QOpenGLShaderProgram*) {}
    virtual void release(QOpenGLShaderProgram*) {}
 
-   void dirty() { m_dirty = true; }
+   /// Marks the component as changed, this also records the change in the scene's journal
+   void dirty() {
+      m_dirty = true;
+      if (m_parent && m_typeIndex != NoTypeIndex) m_parent->componentModified(m_typeIndex);
+   }
    bool isDirty() const { return m_dirty; }
 
+   /// Cuts a copy loose from the scene, e.g. one handed to the renderer. It no longer has a
+   /// parent and its changes aren't recorded anywhere.
+   void detach() {
+      m_parent = nullptr;
+      m_typeIndex = NoTypeIndex;
+   }
+
 protected:
    void clean() { m_dirty = false; }
 
 private:
+   template<typename T>
+   friend struct ComponentsRegistry;
+
+   static constexpr size_t NoTypeIndex = std::numeric_limits<size_t>::max();
+
    Object* m_parent = nullptr;
    bool m_dirty = true;
+   size_t m_typeIndex = NoTypeIndex;
 };
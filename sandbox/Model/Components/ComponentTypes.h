@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+
+struct TransformComponent;
+struct CameraComponent;
+struct MeshComponent;
+struct MaterialComponent;
+struct DirectionalLightSourceComponent;
+
+template<typename... Ts>
+struct type_list {
+   static constexpr std::size_t size = sizeof...(Ts);
+};
+
+template<typename T, typename List>
+struct type_list_index;
+
+template<typename T, typename... Ts>
+struct type_list_index<T, type_list<T, Ts...> > : std::integral_constant<std::size_t, 0> {
+};
+
+template<typename T, typename U, typename... Ts>
+struct type_list_index<T, type_list<U, Ts...> >
+      : std::integral_constant<std::size_t, 1 + type_list_index<T, type_list<Ts...> >::value> {
+};
+
+/// Every component type owns a fixed slot in the registry array of a scene.
+/// New components have to be appended here, the names are only used for serialization and the UI.
+using ComponentTypes = type_list<
+   TransformComponent,
+   CameraComponent,
+   MeshComponent,
+   MaterialComponent,
+   DirectionalLightSourceComponent>;
+
+constexpr std::size_t ComponentTypeCount = ComponentTypes::size;
+
+template<typename T>
+constexpr std::size_t ComponentTypeIndex = type_list_index<std::remove_cv_t<T>, ComponentTypes>::value;
@@ -4,23 +4,47 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QUuid>
+#include <algorithm>
 #include <map>
+#include <span>
+#include <limits>
+#include <array>
+#include "ComponentTypes.h"
+#include "ChangeJournal.h"
+#include "Common/JobSystem.h"
+#include "Model/Serialization/BinaryArchive.h"
+#include "Model/Serialization/JsonStream.h"
+#include <QCborMap>
+#include <QCborValue>
+
+struct ComponentsRegistryBase;
+
+/// One registry per component type, indexed by ComponentTypeIndex<T>
+using ComponentsRegistries = std::array<sptr<ComponentsRegistryBase>, ComponentTypeCount>;
 
 struct GlobalComponentsRegistry {
-   using deletor_fn = std::function<void(std::function<sptr<void>(QString)>, QUuid)>;
-   using copier_fn = std::function<void(const Object*, Object*, sptr<void>)>;
-   using serialize_fn = std::function<QJsonArray(sptr<void>)>;
+   using copier_fn = std::function<void(const Object*, Object*, ComponentsRegistries&)>;
+   using serialize_fn = std::function<QJsonArray(const ComponentsRegistries&)>;
    using object_getter_fn = std::function<Object*(QUuid)>;
-   using deserialize_fn = std::function<void(std::function<void(QString, sptr<void>)>, QJsonArray,
+   using deserialize_fn = std::function<void(ComponentsRegistries&, QJsonArray,
                                              object_getter_fn)>;
    using serialize_map = std::unordered_map<QString, serialize_fn, QtHasher<QString> >;
    using deserialize_map = std::unordered_map<QString, deserialize_fn, QtHasher<QString> >;
    using copier_map = std::unordered_map<QString, copier_fn, QtHasher<QString> >;
-
-   static std::vector<deletor_fn>& Deletors() {
-      static std::vector<deletor_fn> s_deletors;
-      return s_deletors;
-   }
+   using binary_serialize_fn = std::function<void(const ComponentsRegistries&, BinaryWriter&)>;
+   using binary_deserialize_fn = std::function<void(ComponentsRegistries&, BinaryReader&,
+                                                    const object_getter_fn&)>;
+   using binary_serialize_map =
+         std::unordered_map<QString, binary_serialize_fn, QtHasher<QString> >;
+   using binary_deserialize_map =
+         std::unordered_map<QString, binary_deserialize_fn, QtHasher<QString> >;
+   using stream_serialize_fn = std::function<void(const ComponentsRegistries&, JsonStreamWriter&)>;
+   using element_deserialize_fn = std::function<void(ComponentsRegistries&,
+                                                     std::span<const QJsonObject>,
+                                                     const object_getter_fn&)>;
+   using stream_serialize_map = std::unordered_map<QString, stream_serialize_fn, QtHasher<QString> >;
+   using element_deserialize_map =
+         std::unordered_map<QString, element_deserialize_fn, QtHasher<QString> >;
 
    static copier_map& Copiers() {
       static copier_map s_copiers;
@@ -37,20 +61,113 @@ struct GlobalComponentsRegistry {
       return s_deserializers;
    }
 
-   static QJsonObject ToJson(std::function<sptr<void>(QString)> regGetter) {
+   static binary_serialize_map& BinarySerializers() {
+      static binary_serialize_map s_serializers;
+      return s_serializers;
+   }
+
+   static binary_deserialize_map& BinaryDeserializers() {
+      static binary_deserialize_map s_deserializers;
+      return s_deserializers;
+   }
+
+   static stream_serialize_map& StreamSerializers() {
+      static stream_serialize_map s_serializers;
+      return s_serializers;
+   }
+
+   static element_deserialize_map& ElementDeserializers() {
+      static element_deserialize_map s_deserializers;
+      return s_deserializers;
+   }
+
+   /// Components are (de)serialized in chunks of this size on the job system
+   static constexpr size_t SerializeGrain = 64;
+
+   static QJsonObject ToJson(const ComponentsRegistries& registries) {
+      // the types are serialized in parallel and merged afterwards, QJsonObject sorts the keys
+      std::vector<std::pair<QString, const serialize_fn*> > types;
+      for (const auto& [name, fn]: Serializers()) types.emplace_back(name, &fn);
+      std::vector<QJsonArray> arrays(types.size());
+      JobSystem::instance().parallelFor(types.size(), 1, [&](size_t begin, size_t end) {
+         for (size_t i = begin; i < end; ++i) arrays[i] = (*types[i].second)(registries);
+      });
+
       QJsonObject obj;
-      for (const auto& [name, fn]: Serializers()) { obj[name] = fn(regGetter(name)); }
+      for (size_t i = 0; i < types.size(); ++i) obj[types[i].first] = arrays[i];
       return obj;
    }
 
-   static void FromJson(std::function<void(QString, sptr<void>)> regSetter, QJsonObject obj,
+   static void FromJson(ComponentsRegistries& registries, const QJsonObject& obj,
                         const object_getter_fn& getter) {
-      for (const auto& [name, fn]: Deserializers()) { fn(regSetter, obj[name].toArray(), getter); }
+      // every type fills its own registry, so they can be loaded in parallel
+      std::vector<std::pair<const deserialize_fn*, QJsonArray> > types;
+      for (const auto& [name, fn]: Deserializers()) types.emplace_back(&fn, obj[name].toArray());
+      JobSystem::instance().parallelFor(types.size(), 1, [&](size_t begin, size_t end) {
+         for (size_t i = begin; i < end; ++i) (*types[i].first)(registries, types[i].second, getter);
+      });
    }
-};
 
-template<typename T>
-bool create_deletor();
+   /// Same layout as ToJson, but only a window of components is held as json at a time
+   static void ToJson(const ComponentsRegistries& registries, JsonStreamWriter& writer) {
+      std::vector<QString> names;
+      for (const auto& [name, _]: StreamSerializers()) names.push_back(name);
+      std::ranges::sort(names);
+
+      writer.beginObject();
+      for (const auto& name: names) {
+         writer.key(name);
+         writer.beginArray();
+         StreamSerializers()[name](registries, writer);
+         writer.endArray();
+      }
+      writer.endObject();
+   }
+
+   /// Adds elements of the json layout, false if the type is unknown
+   static bool FromJson(ComponentsRegistries& registries, const QString& name,
+                        std::span<const QJsonObject> elements, const object_getter_fn& getter) {
+      auto it = ElementDeserializers().find(name);
+      if (it == ElementDeserializers().end()) return false;
+      it->second(registries, elements, getter);
+      return true;
+   }
+
+   /// Every type is written as its name and byte size followed by its components,
+   /// so readers can skip types they don't know
+   static void ToBinary(const ComponentsRegistries& registries, BinaryWriter& writer) {
+      std::vector<QString> names;
+      for (const auto& [name, _]: BinarySerializers()) names.push_back(name);
+      std::ranges::sort(names);
+
+      writer.record() << quint32(names.size());
+      for (const auto& name: names) {
+         writer.record() << name;
+         const auto sizePosition = writer.position();
+         writer.record() << quint64(0);
+         BinarySerializers()[name](registries, writer);
+         writer.patch(sizePosition, writer.position() - sizePosition - sizeof(quint64));
+      }
+   }
+
+   static void FromBinary(ComponentsRegistries& registries, BinaryReader& reader,
+                          const object_getter_fn& getter) {
+      quint32 count = 0;
+      reader.record() >> count;
+      for (quint32 i = 0; i < count && reader.record().status() == QDataStream::Ok; ++i) {
+         QString name;
+         quint64 size = 0;
+         reader.record() >> name >> size;
+         const auto end = reader.record().device()->pos() + qint64(size);
+         if (auto it = BinaryDeserializers().find(name); it != BinaryDeserializers().end()) {
+            it->second(registries, reader, getter);
+         } else {
+            GS_DEBUG() << "Skipping unknown component type" << name;
+         }
+         reader.record().device()->seek(end);
+      }
+   }
+};
 
 template<typename T>
 bool create_serializer();
@@ -62,43 +179,283 @@ template<typename T>
 bool create_copier();
 
 template<typename T>
-struct ComponentsRegistry {
-   std::unordered_map<QUuid, T, QtHasher<QUuid> >& components() { return m_components; }
+bool create_binary_serializer();
+
+template<typename T>
+bool create_binary_deserializer();
+
+template<typename T>
+bool create_stream_serializer();
+
+template<typename T>
+bool create_element_deserializer();
+
+/// Components with large payloads write them as blobs which can be viewed in place after loading,
+/// all others are stored as their json form encoded in CBOR
+template<typename T>
+concept BinarySerializable = requires(const T& component, T& target, BinaryWriter& writer,
+                                      BinaryReader& reader) {
+   component.write(writer);
+   target.read(reader);
+};
+
+/// Components whose large payloads may still be pending after loading, they load on first use
+template<typename T>
+concept DeferredPayload = requires(const T& component) { component.loadPayload(); };
+
+/// Stable reference to a component slot. Stays valid while the component is alive, even if the
+/// component itself is moved around inside its registry by swap-and-pop removals.
+struct ComponentHandle {
+   static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+
+   uint32_t slot = Invalid;
+   uint32_t generation = 0;
+
+   bool valid() const { return slot != Invalid; }
+   bool operator==(const ComponentHandle& other) const = default;
+};
+
+/// Type erased part of a registry, used wherever the concrete component type is unknown
+struct ComponentsRegistryBase {
+   virtual ~ComponentsRegistryBase() = default;
+   virtual void erase(QUuid id) = 0;
+   virtual bool contains(QUuid id) const = 0;
+   virtual size_t size() const = 0;
+   virtual QString name() const = 0;
+   /// Json of the component of id, empty if there is none
+   virtual QJsonObject componentJson(QUuid id) const = 0;
+   /// Loads the pending payloads of all components
+   virtual void loadPayloads() const = 0;
+   /// Copy for another scene whose objects getter returns, mesh streams are shared until edited
+   virtual sptr<ComponentsRegistryBase> clone(
+         const GlobalComponentsRegistry::object_getter_fn& getter) const = 0;
+
+   /// Additions and removals are recorded by the registry, modifications by Component::dirty()
+   ChangeJournal& journal() { return m_journal; }
+
+protected:
+   ChangeJournal m_journal;
+};
+
+/// Sparse set storage: all components of one type live contiguously in a dense array, an id
+/// index maps entities to slots and every slot knows its current position in the dense array.
+template<typename T>
+struct ComponentsRegistry final : ComponentsRegistryBase {
+   static constexpr size_t TypeIndex = ComponentTypeIndex<T>;
+
+   using iterator = typename std::vector<T>::iterator;
+   using const_iterator = typename std::vector<T>::const_iterator;
+
+   T& emplace(QUuid id, Object* obj) {
+      if (auto* existing = find(id)) return *existing;
+
+      uint32_t slot;
+      if (!m_freeSlots.empty()) {
+         slot = m_freeSlots.back();
+         m_freeSlots.pop_back();
+      } else {
+         slot = static_cast<uint32_t>(m_slots.size());
+         m_slots.push_back({});
+      }
+
+      m_slots[slot].dense = static_cast<uint32_t>(m_dense.size());
+      m_lookup.emplace(id, slot);
+      m_ids.push_back(id);
+      m_denseToSlot.push_back(slot);
+      m_journal.record(id, ChangeKind::Added);
+      auto& component = m_dense.emplace_back(obj);
+      component.m_typeIndex = TypeIndex;
+      return component;
+   }
+
+   void erase(QUuid id) override {
+      auto it = m_lookup.find(id);
+      if (it == m_lookup.end()) return;
+
+      const auto slot = it->second;
+      const auto index = m_slots[slot].dense;
+      const auto last = static_cast<uint32_t>(m_dense.size() - 1);
+
+      // swap-and-pop keeps the dense array free of holes
+      if (index != last) {
+         m_dense[index] = std::move(m_dense[last]);
+         m_ids[index] = m_ids[last];
+         m_denseToSlot[index] = m_denseToSlot[last];
+         m_slots[m_denseToSlot[index]].dense = index;
+      }
+      m_dense.pop_back();
+      m_ids.pop_back();
+      m_denseToSlot.pop_back();
+
+      m_slots[slot].dense = ComponentHandle::Invalid;
+      m_slots[slot].generation++;
+      m_freeSlots.push_back(slot);
+      m_lookup.erase(it);
+      m_journal.record(id, ChangeKind::Removed);
+   }
+
+   bool contains(QUuid id) const override { return m_lookup.contains(id); }
+   QString name() const override { return T::Name; }
+
+   QJsonObject componentJson(QUuid id) const override {
+      const auto* component = find(id);
+      return component ? component->toJson() : QJsonObject();
+   }
+
+   void loadPayloads() const override {
+      if constexpr (DeferredPayload<T>) {
+         JobSystem::instance().parallelFor(m_dense.size(), 1, [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) m_dense[i].loadPayload();
+         });
+      }
+   }
+
+   sptr<ComponentsRegistryBase> clone(
+         const GlobalComponentsRegistry::object_getter_fn& getter) const override {
+      auto copy = std::make_shared<ComponentsRegistry<T> >();
+      // components can't always be assigned, so they are copy constructed one by one
+      copy->m_dense.reserve(m_dense.size());
+      for (size_t i = 0; i < m_dense.size(); ++i) {
+         copy->m_dense.emplace_back(m_dense[i]).m_parent = getter(m_ids[i]);
+      }
+      copy->m_ids = m_ids;
+      copy->m_denseToSlot = m_denseToSlot;
+      copy->m_slots = m_slots;
+      copy->m_freeSlots = m_freeSlots;
+      copy->m_lookup = m_lookup;
+      return copy;
+   }
+
+   T* find(QUuid id) {
+      auto it = m_lookup.find(id);
+      return it == m_lookup.end() ? nullptr : &m_dense[m_slots[it->second].dense];
+   }
+
+   const T* find(QUuid id) const {
+      auto it = m_lookup.find(id);
+      return it == m_lookup.end() ? nullptr : &m_dense[m_slots[it->second].dense];
+   }
+
+   T& at(QUuid id) { return m_dense[m_slots[m_lookup.at(id)].dense]; }
+   const T& at(QUuid id) const { return m_dense[m_slots[m_lookup.at(id)].dense]; }
+
+   ComponentHandle handle(QUuid id) const {
+      auto it = m_lookup.find(id);
+      if (it == m_lookup.end()) return {};
+      return {it->second, m_slots[it->second].generation};
+   }
+
+   T* get(ComponentHandle handle) {
+      if (!handle.valid() || handle.slot >= m_slots.size()) return nullptr;
+      const auto& slot = m_slots[handle.slot];
+      if (slot.generation != handle.generation) return nullptr;
+      return &m_dense[slot.dense];
+   }
+
+   const T* get(ComponentHandle handle) const {
+      return const_cast<ComponentsRegistry*>(this)->get(handle);
+   }
+
+   /// Entity ids in the same order as the dense component array
+   const std::vector<QUuid>& ids() const { return m_ids; }
+   std::span<T> dense() { return m_dense; }
+   std::span<const T> dense() const { return m_dense; }
+
+   size_t size() const override { return m_dense.size(); }
+   bool empty() const { return m_dense.empty(); }
+   void reserve(size_t count) {
+      m_dense.reserve(count);
+      m_ids.reserve(count);
+      m_denseToSlot.reserve(count);
+      m_lookup.reserve(count);
+   }
+
+   iterator begin() { return m_dense.begin(); }
+   iterator end() { return m_dense.end(); }
+   const_iterator begin() const { return m_dense.begin(); }
+   const_iterator end() const { return m_dense.end(); }
 
    static inline bool ComponentTypeRegistered =
-         create_deletor<T>() &&
          create_serializer<T>() &&
          create_deserializer<T>() &&
-         create_copier<T>();
+         create_copier<T>() &&
+         create_binary_serializer<T>() &&
+         create_binary_deserializer<T>() &&
+         create_stream_serializer<T>() &&
+         create_element_deserializer<T>();
 
 private:
-   std::unordered_map<QUuid, T, QtHasher<QUuid> > m_components;
+   struct Slot {
+      uint32_t dense = ComponentHandle::Invalid;
+      uint32_t generation = 0;
+   };
+
+   std::vector<T> m_dense;
+   std::vector<QUuid> m_ids;
+   std::vector<uint32_t> m_denseToSlot;
+   std::vector<Slot> m_slots;
+   std::vector<uint32_t> m_freeSlots;
+   std::unordered_map<QUuid, uint32_t, QtHasher<QUuid> > m_lookup;
 };
 
 
+/// Json of one element of the serialized layout
 template<typename T>
-bool create_deletor() {
-   GlobalComponentsRegistry::Deletors().push_back(
-         [](std::function<sptr<void>(QString)> getter, QUuid id) {
-            auto rawReg = getter(T::Name);
-            if (!rawReg) return;
-            auto reg = std::static_pointer_cast<ComponentsRegistry<T> >(rawReg);
-            reg->components().erase(id);
-         });
-   return true;
+QJsonObject component_to_json(QUuid id, const T& component) {
+   QJsonObject obj;
+   obj["id"] = id.toString();
+   obj["data"] = component.toJson();
+   return obj;
+}
+
+/// Emplaces the components one after another, their json is then applied in parallel
+template<typename T>
+void components_from_json(ComponentsRegistry<T>& reg, std::span<const QJsonObject> elements,
+                          const GlobalComponentsRegistry::object_getter_fn& getter) {
+   const auto before = reg.size();
+   std::vector<std::pair<size_t, QJsonObject> > work;
+   work.reserve(elements.size());
+   for (const auto& element: elements) {
+      auto id = QUuid::fromString(element["id"].toString());
+      auto* obj = getter(id);
+      if (!obj) {
+         GS_DEBUG() << "Skipping" << T::Name << "of unknown object" << id;
+         continue;
+      }
+      auto& component = reg.emplace(id, obj);
+      work.emplace_back(&component - reg.dense().data(), element["data"].toObject());
+   }
+
+   // a component listed twice ends up with the json listed last, like a serial load
+   if (reg.size() - before != work.size()) {
+      std::ranges::stable_sort(work, {}, &std::pair<size_t, QJsonObject>::first);
+      auto last = std::ranges::unique(work.rbegin(), work.rend(), {},
+                                      &std::pair<size_t, QJsonObject>::first);
+      work.erase(work.begin(), last.begin().base());
+   }
+
+   auto components = reg.dense();
+   JobSystem::instance().parallelFor(work.size(), GlobalComponentsRegistry::SerializeGrain,
+                                     [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) components[work[i].first].fromJson(work[i].second);
+   });
 }
 
 template<typename T>
 bool create_serializer() {
-   GlobalComponentsRegistry::Serializers()[T::Name] = [](sptr<void> o) {
-      auto reg = std::static_pointer_cast<ComponentsRegistry<T> >(o);
+   GlobalComponentsRegistry::Serializers()[T::Name] = [](const ComponentsRegistries& registries) {
       QJsonArray arr;
-      for (const auto& [id, component]: reg->components()) {
-         QJsonObject obj;
-         obj["id"] = id.toString();
-         obj["data"] = component.toJson();
-         arr.append(obj);
-      }
+      auto* reg = static_cast<ComponentsRegistry<T>*>(registries[ComponentTypeIndex<T>].get());
+      if (!reg) return arr;
+
+      const auto& ids = reg->ids();
+      const auto components = reg->dense();
+      std::vector<QJsonObject> objects(components.size());
+      JobSystem::instance().parallelFor(components.size(), GlobalComponentsRegistry::SerializeGrain,
+                                        [&](size_t begin, size_t end) {
+         for (size_t i = begin; i < end; ++i) objects[i] = component_to_json(ids[i], components[i]);
+      });
+      for (const auto& obj: objects) arr.append(obj);
       return arr;
    };
    return true;
@@ -107,29 +464,129 @@ bool create_serializer() {
 template<typename T>
 bool create_deserializer() {
    GlobalComponentsRegistry::Deserializers()[T::Name] = [
-         ](std::function<void(QString, sptr<void>)> regSetter, QJsonArray arr,
+         ](ComponentsRegistries& registries, QJsonArray arr,
            const GlobalComponentsRegistry::object_getter_fn& getter) {
             auto reg = std::make_shared<ComponentsRegistry<T> >();
-            for (const auto& obj: arr) {
-               auto id = QUuid::fromString(obj.toObject()["id"].toString());
-               auto data = obj.toObject()["data"].toObject();
-               reg->components().emplace(id, getter(id));
-               reg->components().at(id).fromJson(data);
-            }
-            regSetter(T::Name, reg);
+            reg->reserve(arr.size());
+            std::vector<QJsonObject> elements;
+            elements.reserve(arr.size());
+            for (const auto& obj: arr) elements.push_back(obj.toObject());
+            components_from_json(*reg, elements, getter);
+            registries[ComponentTypeIndex<T>] = std::move(reg);
          };
    return true;
 }
 
 template<typename T>
 bool create_copier() {
-   GlobalComponentsRegistry::Copiers()[T::Name] = [](const Object* from, Object* to, sptr<void> o) {
-      auto reg = std::static_pointer_cast<ComponentsRegistry<T> >(o);
-      if (!reg->components().contains(from->id())) return;
-      auto& component = reg->components().at(from->id());
-      auto serialized = component.toJson();
-      reg->components().emplace(to->id(), to);
-      reg->components().at(to->id()).fromJson(serialized);
+   GlobalComponentsRegistry::Copiers()[T::Name] = [](const Object* from, Object* to,
+                                                     ComponentsRegistries& registries) {
+      auto* reg = static_cast<ComponentsRegistry<T>*>(registries[ComponentTypeIndex<T>].get());
+      if (!reg) return;
+      auto* component = reg->find(from->id());
+      if (!component) return;
+      // serialize first, emplacing may relocate the dense array
+      auto serialized = component->toJson();
+      reg->emplace(to->id(), to).fromJson(serialized);
+   };
+   return true;
+}
+
+template<typename T>
+bool create_binary_serializer() {
+   GlobalComponentsRegistry::BinarySerializers()[T::Name] = [](const ComponentsRegistries& registries,
+                                                               BinaryWriter& writer) {
+      auto* reg = static_cast<ComponentsRegistry<T>*>(registries[ComponentTypeIndex<T>].get());
+      if (!reg) {
+         writer.record() << quint64(0);
+         return;
+      }
+
+      const auto& ids = reg->ids();
+      const auto components = reg->dense();
+      writer.record() << quint64(components.size());
+      for (size_t i = 0; i < components.size(); ++i) {
+         writer.record() << ids[i];
+         if constexpr (BinarySerializable<T>) {
+            components[i].write(writer);
+         } else {
+            writer.record() << QCborMap::fromJsonObject(components[i].toJson()).toCborValue().toCbor();
+         }
+      }
+   };
+   return true;
+}
+
+template<typename T>
+bool create_binary_deserializer() {
+   GlobalComponentsRegistry::BinaryDeserializers()[T::Name] = [
+         ](ComponentsRegistries& registries, BinaryReader& reader,
+           const GlobalComponentsRegistry::object_getter_fn& getter) {
+            quint64 count = 0;
+            reader.record() >> count;
+            auto reg = std::make_shared<ComponentsRegistry<T> >();
+            // every component takes at least its id, so a broken count can't reserve too much
+            reg->reserve(std::min<quint64>(count, reader.record().device()->bytesAvailable()));
+            for (quint64 i = 0; i < count && reader.record().status() == QDataStream::Ok; ++i) {
+               QUuid id;
+               reader.record() >> id;
+               auto* obj = getter(id);
+               if (!obj) GS_DEBUG() << "Skipping" << T::Name << "of unknown object" << id;
+               if constexpr (BinarySerializable<T>) {
+                  // the record is still read so the next one starts at the right place
+                  T skipped(nullptr);
+                  (obj ? reg->emplace(id, obj) : skipped).read(reader);
+               } else {
+                  QByteArray cbor;
+                  reader.record() >> cbor;
+                  if (obj) {
+                     reg->emplace(id, obj).fromJson(
+                           QCborValue::fromCbor(cbor).toMap().toJsonObject());
+                  }
+               }
+            }
+            registries[ComponentTypeIndex<T>] = std::move(reg);
+         };
+   return true;
+}
+
+template<typename T>
+bool create_stream_serializer() {
+   GlobalComponentsRegistry::StreamSerializers()[T::Name] = [](const ComponentsRegistries& registries,
+                                                               JsonStreamWriter& writer) {
+      auto* reg = static_cast<ComponentsRegistry<T>*>(registries[ComponentTypeIndex<T>].get());
+      if (!reg) return;
+
+      // a window is encoded in parallel and written in order before the next one starts
+      auto& jobs = JobSystem::instance();
+      const auto grain = GlobalComponentsRegistry::SerializeGrain;
+      const auto window = grain * std::max<size_t>(jobs.workerCount(), 1);
+      const auto& ids = reg->ids();
+      const auto components = reg->dense();
+      std::vector<QByteArray> encoded;
+      for (size_t first = 0; first < components.size(); first += window) {
+         encoded.assign(std::min(window, components.size() - first), {});
+         jobs.parallelFor(encoded.size(), grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+               encoded[i] = JsonStreamWriter::encode(
+                     component_to_json(ids[first + i], components[first + i]));
+            }
+         });
+         for (const auto& json: encoded) writer.encodedValue(json);
+      }
    };
    return true;
 }
+
+template<typename T>
+bool create_element_deserializer() {
+   GlobalComponentsRegistry::ElementDeserializers()[T::Name] = [
+         ](ComponentsRegistries& registries, std::span<const QJsonObject> elements,
+           const GlobalComponentsRegistry::object_getter_fn& getter) {
+            auto& base = registries[ComponentTypeIndex<T>];
+            if (!base) base = std::make_shared<ComponentsRegistry<T> >();
+            auto& reg = static_cast<ComponentsRegistry<T>&>(*base);
+            components_from_json(reg, elements, getter);
+         };
+   return true;
+}
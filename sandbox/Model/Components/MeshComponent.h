@@ -3,9 +3,12 @@
 #include "Common/Common.h"
 #include "Component.h"
 #include "ComponentsRegistry.h"
+#include "MeshStream.h"
+#include "Model/Serialization/PackedStream.h"
 #include <QVector3D>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <QOpenGLBuffer>
 
 struct MeshComponent : Component {
@@ -13,73 +16,104 @@ struct MeshComponent : Component {
 
    using Component::Component;
 
-   // we use structure of arrays instead of array of structures
-
-   std::vector<QVector3D> vertices;
-   std::vector<QVector2D> uvs;
-   std::vector<QVector3D> normals;
-   std::vector<uint16_t> indices;
-
-   QJsonObject toJson() const override {
-      REG_ASSERT(ComponentsRegistry<MeshComponent>::ComponentTypeRegistered);
-      QJsonObject json;
+   // components live in a dense array and get moved around, so the GPU buffers must never be
+   // shared between two instances: copies only take the data, moves steal the buffers
+   MeshComponent(const MeshComponent& other)
+      : Component(other), vertices(other.vertices), uvs(other.uvs), normals(other.normals),
+        indices(other.indices) {}
+
+   MeshComponent(MeshComponent&& other) noexcept
+      : Component(std::move(other)), vertices(std::move(other.vertices)),
+        uvs(std::move(other.uvs)), normals(std::move(other.normals)),
+        indices(std::move(other.indices)),
+        m_vertexBuffer(std::exchange(other.m_vertexBuffer, nullptr)),
+        m_uvBuffer(std::exchange(other.m_uvBuffer, nullptr)),
+        m_normalBuffer(std::exchange(other.m_normalBuffer, nullptr)),
+        m_indexBuffer(std::exchange(other.m_indexBuffer, nullptr)) {}
+
+   MeshComponent& operator=(const MeshComponent& other) = delete;
+
+   MeshComponent& operator=(MeshComponent&& other) noexcept {
+      if (this == &other) return *this;
+      Component::operator=(std::move(other));
+      vertices = std::move(other.vertices);
+      uvs = std::move(other.uvs);
+      normals = std::move(other.normals);
+      indices = std::move(other.indices);
+      std::swap(m_vertexBuffer, other.m_vertexBuffer);
+      std::swap(m_uvBuffer, other.m_uvBuffer);
+      std::swap(m_normalBuffer, other.m_normalBuffer);
+      std::swap(m_indexBuffer, other.m_indexBuffer);
+      return *this;
+   }
 
-      // vertices
-      QJsonArray verticesArray;
-      for (auto& vertex: vertices) {
-         QJsonObject vertexObj;
-         vertexObj["position"] = QJsonArray{vertex.x(), vertex.y(), vertex.z()};
-         verticesArray.append(vertexObj);
-      }
-      json["vertices"] = verticesArray;
+   // we use structure of arrays instead of array of structures, copies share the streams
 
-      // uvs
-      QJsonArray uvsArray;
-      for (auto& uv: uvs) { uvsArray.append(QJsonArray{uv.x(), uv.y()}); }
-      json["uvs"] = uvsArray;
+   MeshStream<QVector3D> vertices;
+   MeshStream<QVector2D> uvs;
+   MeshStream<QVector3D> normals;
+   MeshStream<uint16_t> indices;
 
-      // normals
-      QJsonArray normalsArray;
-      for (auto& normal: normals) {
-         normalsArray.append(QJsonArray{normal.x(), normal.y(), normal.z()});
-      }
-      json["normals"] = normalsArray;
+   /// The streams are stored as blobs, after loading they view the mapped file or are
+   /// decompressed on first use
+   void write(BinaryWriter& writer) const {
+      writer.record() << writer.blob(vertices) << writer.blob(uvs) << writer.blob(normals)
+            << writer.blob(indices);
+   }
 
-      // indices
-      QJsonArray indicesArray;
-      for (auto& index: indices) { indicesArray.append(index); }
-      json["indices"] = indicesArray;
+   void read(BinaryReader& reader) {
+      BlobRef vertexBlob, uvBlob, normalBlob, indexBlob;
+      reader.record() >> vertexBlob >> uvBlob >> normalBlob >> indexBlob;
+      vertices = reader.stream<QVector3D>(vertexBlob);
+      uvs = reader.stream<QVector2D>(uvBlob);
+      normals = reader.stream<QVector3D>(normalBlob);
+      indices = reader.stream<uint16_t>(indexBlob);
+   }
 
+   /// Every stream is packed into a single base64 buffer, see PackedStream
+   QJsonObject toJson() const override {
+      REG_ASSERT(ComponentsRegistry<MeshComponent>::ComponentTypeRegistered);
+      QJsonObject json;
+      json["vertices"] = PackedStream::pack(vertices);
+      json["uvs"] = PackedStream::pack(uvs);
+      json["normals"] = PackedStream::pack(normals);
+      json["indices"] = PackedStream::pack(indices);
       return json;
    }
 
    void fromJson(const QJsonObject& json) override {
-      auto verticesArray = json["vertices"].toArray();
-      for (auto vertex: verticesArray) {
-         auto vertexObj = vertex.toObject();
-         auto position = vertexObj["position"].toArray();
-         vertices.push_back(QVector3D(position[0].toDouble(), position[1].toDouble(),
-                                      position[2].toDouble()));
-      }
-
-      auto uvsArray = json["uvs"].toArray();
-      for (auto uv: uvsArray) {
+      readStream(json["vertices"], vertices, [](const QJsonValue& vertex) {
+         auto position = vertex.toObject()["position"].toArray();
+         return QVector3D(position[0].toDouble(), position[1].toDouble(), position[2].toDouble());
+      });
+      readStream(json["uvs"], uvs, [](const QJsonValue& uv) {
          auto uvArray = uv.toArray();
-         uvs.push_back(QVector2D(uvArray[0].toDouble(), uvArray[1].toDouble()));
-      }
-
-      auto normalsArray = json["normals"].toArray();
-      for (auto normal: normalsArray) {
+         return QVector2D(uvArray[0].toDouble(), uvArray[1].toDouble());
+      });
+      readStream(json["normals"], normals, [](const QJsonValue& normal) {
          auto normalArray = normal.toArray();
-         normals.push_back(QVector3D(normalArray[0].toDouble(), normalArray[1].toDouble(),
-                                     normalArray[2].toDouble()));
-      }
+         return QVector3D(normalArray[0].toDouble(), normalArray[1].toDouble(),
+                          normalArray[2].toDouble());
+      });
+      readStream(json["indices"], indices, [](const QJsonValue& index) {
+         return uint16_t(index.toInt());
+      });
+   }
 
-      auto indicesArray = json["indices"].toArray();
-      for (auto index: indicesArray) { indices.push_back(index.toInt()); }
+   /// Loads the deferred streams, sizes are only final afterwards
+   void loadPayload() const {
+      vertices.load();
+      uvs.load();
+      normals.load();
+      indices.load();
+   }
+
+   bool isPayloadLoaded() const {
+      return vertices.isLoaded() && uvs.isLoaded() && normals.isLoaded() && indices.isLoaded();
    }
 
    void prepare(QOpenGLShaderProgram* program) override {
+      loadPayload();
       if (m_vertexBuffer == nullptr || isDirty()) {
          delete m_vertexBuffer;
          if (!vertices.empty()) {
@@ -167,6 +201,23 @@ struct MeshComponent : Component {
       delete m_indexBuffer;
    }
 
+private:
+   /// Streams are packed objects whose large payloads are decoded on first use, older scenes
+   /// store one json value per element
+   template<typename T, typename F>
+   static void readStream(const QJsonValue& json, MeshStream<T>& stream, F&& element) {
+      if (json.isObject()) {
+         if (!PackedStream::defer(json.toObject(), stream)) stream.clear();
+         return;
+      }
+
+      const auto array = json.toArray();
+      std::vector<T> elements;
+      elements.reserve(array.size());
+      for (const auto& value: array) elements.push_back(element(value));
+      stream = std::move(elements);
+   }
+
 private:
    QOpenGLBuffer* m_vertexBuffer = nullptr;
    QOpenGLBuffer* m_uvBuffer = nullptr;
@@ -0,0 +1,125 @@
+#pragma once
+#include "Common/Common.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+/// One attribute stream of a mesh. Copies share the elements until one of them is edited, and a
+/// stream can also view memory owned by someone else, like a memory mapped scene file.
+/// Streams are only edited by the thread owning the scene, copies may be read anywhere.
+/// Deferred streams only know their size until the elements are accessed for the first time,
+/// they are then loaded once for all copies.
+template<typename T>
+class MeshStream {
+public:
+   using Loader = std::function<MeshStream()>;
+
+   MeshStream() = default;
+   MeshStream(std::vector<T> elements)
+      : m_owned(std::make_shared<std::vector<T> >(std::move(elements))) {}
+   MeshStream(std::initializer_list<T> elements) : MeshStream(std::vector<T>(elements)) {}
+
+   /// Views size elements at data without copying them, owner keeps the memory alive
+   static MeshStream View(const T* data, size_t size, sptr<const void> owner) {
+      MeshStream stream;
+      stream.m_view = data;
+      stream.m_viewSize = size;
+      stream.m_owner = std::move(owner);
+      return stream;
+   }
+
+   /// Stream of size elements which are loaded on first access, the loader may run on any thread
+   static MeshStream Deferred(size_t size, Loader loader) {
+      MeshStream stream;
+      stream.m_deferred = std::make_shared<Pending>();
+      stream.m_deferred->load = std::move(loader);
+      stream.m_viewSize = size;
+      return stream;
+   }
+
+   const T* data() const {
+      if (m_deferred) return loaded().data();
+      return m_owned ? m_owned->data() : m_view;
+   }
+
+   /// The size of a deferred stream is known without loading it
+   size_t size() const {
+      if (m_deferred) return m_deferred->done ? m_deferred->stream.size() : m_viewSize;
+      return m_owned ? m_owned->size() : m_viewSize;
+   }
+
+   bool empty() const { return size() == 0; }
+   const T* begin() const { return data(); }
+   const T* end() const { return data() + size(); }
+   const T& operator[](size_t index) const { return data()[index]; }
+
+   /// Whether the elements live in memory the stream doesn't own
+   bool isView() const { return m_deferred ? loaded().isView() : !m_owned && m_view; }
+
+   bool isLoaded() const { return !m_deferred || m_deferred->done; }
+   void load() const {
+      if (m_deferred) loaded();
+   }
+
+   /// Mutable elements, they are copied first if they are shared or only viewed.
+   /// The reference is only valid until the stream is copied or assigned.
+   std::vector<T>& edit() {
+      if (m_deferred) {
+         auto stream = loaded();
+         *this = std::move(stream);
+      }
+      if (!m_owned) {
+         m_owned = std::make_shared<std::vector<T> >(m_view, m_view + m_viewSize);
+         m_view = nullptr;
+         m_viewSize = 0;
+         m_owner.reset();
+      } else if (m_owned.use_count() > 1) {
+         m_owned = std::make_shared<std::vector<T> >(*m_owned);
+      }
+      return *m_owned;
+   }
+
+   void push_back(const T& value) { edit().push_back(value); }
+
+   template<typename... Args>
+   T& emplace_back(Args&&... args) { return edit().emplace_back(std::forward<Args>(args)...); }
+
+   void reserve(size_t count) { edit().reserve(count); }
+   void clear() { *this = MeshStream(); }
+
+   bool operator==(const MeshStream& other) const {
+      return data() == other.data() ? size() == other.size()
+                                    : std::equal(begin(), end(), other.begin(), other.end());
+   }
+
+   bool operator==(const std::vector<T>& other) const {
+      return std::equal(begin(), end(), other.begin(), other.end());
+   }
+
+private:
+   struct Pending {
+      std::once_flag once;
+      Loader load;
+      MeshStream stream;
+      std::atomic<bool> done = false;
+   };
+
+   const MeshStream& loaded() const {
+      std::call_once(m_deferred->once, [&pending = *m_deferred] {
+         pending.stream = pending.load();
+         pending.load = nullptr;
+         pending.done = true;
+      });
+      return m_deferred->stream;
+   }
+
+private:
+   sptr<std::vector<T> > m_owned;
+   const T* m_view = nullptr;
+   size_t m_viewSize = 0;
+   sptr<const void> m_owner;
+   sptr<Pending> m_deferred;
+};
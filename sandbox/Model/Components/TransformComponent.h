@@ -2,6 +2,7 @@
 #include "Component.h"
 #include "Model/Hierarchy/Object.h"
 #include "ComponentsRegistry.h"
+#include "Model/Math/TransformMath.h"
 #include <QQuaternion>
 #include <QVector3D>
 #include <QDebug>
@@ -34,62 +35,42 @@ struct TransformComponent : Component {
       scale = QVector3D(sca[0].toDouble(), sca[1].toDouble(), sca[2].toDouble());
    }
 
-   QMatrix4x4 modelMatrix() const {
-      static QMatrix4x4 defaultMatrix;
-      defaultMatrix.translate(QVector3D());
-      defaultMatrix.rotate(QQuaternion());
-      defaultMatrix.scale(QVector3D(1, 1, 1));
+   void write(BinaryWriter& writer) const { writer.record() << position << rotation << scale; }
+   void read(BinaryReader& reader) { reader.record() >> position >> rotation >> scale; }
 
-      QMatrix4x4 parentModel = hasParent() && parent().parent()
-                                  ? (*parent().parent())->getComponent<TransformComponent>().
-                                  modelMatrix()
-                                  : defaultMatrix;
+   QMatrix4x4 localMatrix() const { return TransformMath::composeTRS(position, rotation, scale); }
 
-      QMatrix4x4 model;
-      model.translate(position);
-      model.rotate(rotation);
-      model.scale(scale);
-
-      return parentModel * model;
-   }
+   /// World matrix of the transform. Transforms of a scene return the matrix cached by
+   /// Scene::updateTransforms(), standalone ones have no parents and only consist of themselves.
+   QMatrix4x4 modelMatrix() const { return hasParent() ? m_world : localMatrix(); }
 
    TransformComponent toGlobal() const { return FromMatrix(modelMatrix()); }
 
    TransformComponent fromGlobal(const TransformComponent& global) const {
       if (!hasParent() || !parent().parent()) return global;
+      return fromGlobal(global.modelMatrix());
+   }
+
+   /// Local transform that results in the given world matrix under the current parent
+   TransformComponent fromGlobal(const QMatrix4x4& global) const {
+      if (!hasParent() || !parent().parent()) return FromMatrix(global);
       auto parentModel = (*parent().parent())->getComponent<TransformComponent>().modelMatrix();
-      auto globalMatrix = global.modelMatrix();
-      auto localMatrix = parentModel.inverted() * globalMatrix;
-      return FromMatrix(localMatrix);
+      return FromMatrix(TransformMath::inverseAffine(parentModel) * global);
    }
 
    static TransformComponent FromMatrix(const QMatrix4x4& matrix) {
-      // decompose global matrix
-      QVector3D pos, scale;
-      QQuaternion rot;
-      pos = matrix.column(3).toVector3D();
-      scale.setX(matrix.column(0).toVector3D().length());
-      scale.setY(matrix.column(1).toVector3D().length());
-      scale.setZ(matrix.column(2).toVector3D().length());
-      QMatrix3x3 rotMat;
-      rotMat(0, 0) = matrix(0, 0) / scale.x();
-      rotMat(0, 1) = matrix(0, 1) / scale.y();
-      rotMat(0, 2) = matrix(0, 2) / scale.z();
-      rotMat(1, 0) = matrix(1, 0) / scale.x();
-      rotMat(1, 1) = matrix(1, 1) / scale.y();
-      rotMat(1, 2) = matrix(1, 2) / scale.z();
-      rotMat(2, 0) = matrix(2, 0) / scale.x();
-      rotMat(2, 1) = matrix(2, 1) / scale.y();
-      rotMat(2, 2) = matrix(2, 2) / scale.z();
-      rot = QQuaternion::fromRotationMatrix(rotMat);
-
+      auto [pos, rot, scale] = TransformMath::decompose(matrix);
       TransformComponent result(nullptr);
       result.position = pos;
       result.rotation = rot;
       result.scale = scale;
-
       return result;
    }
+
+private:
+   friend class Scene;
+
+   QMatrix4x4 m_world;
 };
 
 inline QDataStream& operator<<(QDataStream& stream, const TransformComponent& transform) {
@@ -17,7 +17,7 @@ uptr<Object> Object::createFromJson(const QJsonObject& json, Scene& scene) {
    obj->m_id = QUuid::fromString(json["id"].toString());
    obj->setName(json["name"].toString());
    obj->enable(json["enabled"].toBool(true));
-   obj->setOrder(json["order"].toVariant().toULongLong());
+   obj->setOrder(json["order"].toString().toULongLong());
    return obj;
 }
 
@@ -26,17 +26,36 @@ QJsonObject Object::toJson() const {
    json["id"] = m_id.toString();
    json["name"] = m_name;
    json["enabled"] = m_enabled;
-   json["order"] = QVariant::fromValue(m_order).toJsonObject();
+   // as string since json numbers are doubles and can't hold all 64 bits
+   json["order"] = QString::number(m_order);
    return json;
 }
 
+uptr<Object> Object::createFromBinary(QDataStream& stream, Scene& scene) {
+   auto obj = uptr<Object>(new Object());
+   obj->m_parent = &scene;
+   QString name;
+   bool enabled;
+   quint64 order;
+   stream >> obj->m_id >> name >> enabled >> order;
+   obj->setName(name);
+   obj->enable(enabled);
+   obj->setOrder(order);
+   return obj;
+}
+
+void Object::write(QDataStream& stream) const {
+   stream << m_id << m_name << m_enabled << quint64(m_order);
+}
+
 const QUuid& Object::id() const {
    return m_id;
 }
 
 void Object::setName(const QString& name) {
    if (m_name == name) return;
-   m_name = name;
+   auto oldName = std::exchange(m_name, name);
+   if (m_parent) m_parent->renameObject(this, oldName);
 }
 
 const QString& Object::name() const {
@@ -70,27 +89,51 @@ uint64_t Object::order() const {
 }
 
 void Object::setOrder(uint64_t order) {
-   m_order = order;
+   if (m_order == order) return;
+   auto oldOrder = std::exchange(m_order, order);
+   if (m_parent) m_parent->reorderObject(this, oldOrder);
 }
 
 Object::~Object() {
+   // objects removed in bulk have already been detached by the scene
+   if (!m_parent) return;
+
    // remove parent child associations
    unsetParent();
 
    // remove all components associated with this object
-   if (m_parent) {
-      m_parent->unregister(this);
-   }
+   m_parent->unregister(this);
+}
+
+void Object::componentModified(size_t typeIndex) {
+   if (m_parent) m_parent->componentModified(this, typeIndex);
 }
 
 bool Object::enabled() const {
-   auto pt = parent();
-   return m_enabled && (!pt.has_value() || (*pt)->enabled());
+   return m_effectiveEnabled;
+}
+
+bool Object::enabledSelf() const {
+   return m_enabled;
 }
 
 void Object::enable(bool enable) {
    m_enabled = enable;
+   if (m_parent) m_parent->objectChanged(*this);
+   updateEnabled();
    for (auto* child : children()) {
       child->enable(enable);
    }
 }
+
+void Object::updateEnabled(bool force) {
+   auto pt = parent();
+   const bool effective = m_enabled && (!pt.has_value() || (*pt)->m_effectiveEnabled);
+   if (!force && effective == m_effectiveEnabled) return;
+
+   // the subtree below only has to be visited if something changed
+   m_effectiveEnabled = effective;
+   for (auto* child : children()) {
+      child->updateEnabled(force);
+   }
+}
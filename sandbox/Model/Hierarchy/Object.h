@@ -17,6 +17,8 @@ public:
    static uptr<Object> create(Scene& parent);
    static uptr<Object> createFromJson(const QJsonObject& json, Scene& scene);
    QJsonObject toJson() const;
+   static uptr<Object> createFromBinary(QDataStream& stream, Scene& scene);
+   void write(QDataStream& stream) const;
 
    const QUuid& id() const;
 
@@ -29,10 +31,14 @@ public:
    std::vector<Object*> children() const;
    Scene* scene() const;
 
+   /// Position among the siblings, keys are sparse and only comparable between siblings
    uint64_t order() const;
+   /// Moves the object to the given key, if a sibling already uses it the object goes last
    void setOrder(uint64_t order);
 
+   /// Whether the object and all of its ancestors are enabled, this is cached and O(1)
    bool enabled() const;
+   bool enabledSelf() const;
    void enable(bool enable);
 
    template <typename T> T& getComponent();
@@ -44,10 +50,17 @@ public:
 protected:
    Object() = default;
 
+private:
+   friend struct Component;
+   void componentModified(size_t typeIndex);
+   void updateEnabled(bool force = false);
+
 private:
    QUuid m_id = QUuid::createUuid();
    QString m_name = "<unnamed>";
    bool m_enabled = true;
+   bool m_effectiveEnabled = true;
    uint64_t m_order = 0;
+   uint64_t m_sequence = 0;// when it was added to the scene, the first of equal names wins
    Scene* m_parent = nullptr;
 };
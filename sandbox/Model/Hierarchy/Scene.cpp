@@ -2,89 +2,65 @@
 #include "Object.h"
 #include "Model/Components/ComponentsRegistry.h"
 #include <QJsonArray>
+#include <algorithm>
+#include <limits>
 #include <ranges>
 #include <unordered_set>
 
 #include "Common/AssetProvider.h"
+#include "Common/JobSystem.h"
+#include "Model/Math/TransformMath.h"
 
 namespace {
-   QMatrix4x4 toMatrix(QVector3D pos, QQuaternion rot, QVector3D scale) {
-      QMatrix4x4 matrix;
-      matrix.translate(pos);
-      matrix.rotate(rot);
-      matrix.scale(scale);
-      return matrix;
-   }
-
-   QMatrix4x4 toMatrix(const TransformComponent& transform) {
-      return toMatrix(transform.position, transform.rotation, transform.scale);
-   }
-
-   std::tuple<QVector3D, QQuaternion, QVector3D> fromMatrix(const QMatrix4x4& matrix) {
-      QVector3D pos, scale;
-      QQuaternion rot;
+   constexpr SectionTag ObjectsSection = {'O', 'B', 'J', 'S'};
+   constexpr SectionTag HierarchySection = {'H', 'I', 'E', 'R'};
+   constexpr SectionTag ComponentsSection = {'C', 'O', 'M', 'P'};
+   constexpr SectionTag AssetsSection = {'A', 'S', 'S', 'T'};
 
-      pos = matrix.column(3).toVector3D();
-      scale.setX(matrix.column(0).toVector3D().length());
-      scale.setY(matrix.column(1).toVector3D().length());
-      scale.setZ(matrix.column(2).toVector3D().length());
-      QMatrix3x3 rotMat;
-      rotMat(0, 0) = matrix(0, 0) / scale.x();
-      rotMat(0, 1) = matrix(0, 1) / scale.y();
-      rotMat(0, 2) = matrix(0, 2) / scale.z();
-      rotMat(1, 0) = matrix(1, 0) / scale.x();
-      rotMat(1, 1) = matrix(1, 1) / scale.y();
-      rotMat(1, 2) = matrix(1, 2) / scale.z();
-      rotMat(2, 0) = matrix(2, 0) / scale.x();
-      rotMat(2, 1) = matrix(2, 1) / scale.y();
-      rotMat(2, 2) = matrix(2, 2) / scale.z();
-      rot = QQuaternion::fromRotationMatrix(rotMat);
-      return {pos, rot, scale};
-   }
+   /// Components of one type read from a json stream before they are parsed in parallel
+   constexpr size_t ComponentBatch = 4096;
 }
 
 uptr<Scene> Scene::createEmpty() { return uptr<Scene>(new Scene()); }
 
 uptr<Scene> Scene::createFromJson(const QJsonObject& json) {
    uptr<Scene> scene(new Scene());
+   // components of unknown objects are skipped by the registry
    std::function objectGetter = [scene = scene.get()](QUuid id) -> Object* {
-      return scene->findObject(id).value();
+      return scene->findObject(id).value_or(nullptr);
    };
 
+   LoadedOrders orders;
    for (const auto& obj: json["objects"].toArray()) {
-      scene->addObject(Object::createFromJson(obj.toObject(), *scene));
+      scene->addLoadedObject(Object::createFromJson(obj.toObject(), *scene), orders);
    }
 
-   auto regSetter = [scene = scene.get()](QString name, sptr<void> o) {
-      scene->m_componentsRegistrar[name] = std::move(o);
-   };
    auto childrenAssoc = json["children"].toObject();
 
    for (const auto& parent: childrenAssoc.keys()) {
       auto parentID = QUuid::fromString(parent);
       auto children = childrenAssoc[parent].toArray();
       for (const auto& child: children) {
-         auto childID = QUuid::fromString(child.toString());
-         scene->m_children[parentID].push_back(childID);
+         scene->linkChild(parentID, QUuid::fromString(child.toString()));
       }
    }
 
    GS_DEBUG() << "Found components:" << transform(GlobalComponentsRegistry::Serializers(),
                                                    [](auto& pair) { return pair.first; });
-   GlobalComponentsRegistry::FromJson(regSetter, json["components"].toObject(), objectGetter);
+   GlobalComponentsRegistry::FromJson(scene->m_registries, json["components"].toObject(),
+                                      objectGetter);
    AssetProvider::instance().fromJson(json["assets"].toObject());
+   scene->finishLoading(orders);
 
    return scene;
 }
 
 QJsonObject Scene::toJson() const {
-   auto getter = [this](QString name) { return m_componentsRegistrar.at(name); };
-
    QJsonObject json;
    QJsonArray objects;
    for (const auto& obj: m_objects) { objects.append(obj->toJson()); }
    json["objects"] = objects;
-   json["components"] = GlobalComponentsRegistry::ToJson(getter);
+   json["components"] = GlobalComponentsRegistry::ToJson(m_registries);
    QJsonObject childrenObject;
    for (const auto& [parent, children]: m_children) {
       QJsonArray childrenArray;
@@ -96,60 +72,459 @@ QJsonObject Scene::toJson() const {
    return json;
 }
 
+uptr<Scene> Scene::createFromJson(JsonStreamReader& reader, const sptr<AssetStore>& store,
+                                  AssetProvider* assets) {
+   uptr<Scene> scene(new Scene());
+   std::function objectGetter = [scene = scene.get()](QUuid id) -> Object* {
+      return scene->findObject(id).value_or(nullptr);
+   };
+
+   // components are read in batches which are parsed and applied in parallel. Files written by
+   // toJson have their keys sorted, so the components may come before the objects they belong to
+   // and are kept until the objects are known.
+   LoadedOrders orders;
+   bool objectsLoaded = false;
+   std::atomic<bool> malformed = false;
+   using RawBatch = std::pair<QString, std::vector<QByteArray>>;
+   std::vector<RawBatch> pendingBatches;
+   auto addComponents = [&](const RawBatch& batch) {
+      const auto& [type, raw] = batch;
+      std::vector<QJsonObject> elements(raw.size());
+      JobSystem::instance().parallelFor(raw.size(), GlobalComponentsRegistry::SerializeGrain,
+                                        [&](size_t begin, size_t end) {
+         for (size_t i = begin; i < end; ++i) {
+            bool ok;
+            elements[i] = JsonStreamReader::parse(raw[i], &ok).toObject();
+            if (!ok) malformed = true;
+         }
+      });
+      if (!GlobalComponentsRegistry::FromJson(scene->m_registries, type, elements, objectGetter)) {
+         GS_DEBUG() << "Skipping unknown component type" << type;
+      }
+   };
+   auto flush = [&](RawBatch& batch) {
+      if (batch.second.empty()) return;
+      if (objectsLoaded) addComponents(batch);
+      else pendingBatches.emplace_back(batch.first, std::move(batch.second));
+      batch.second.clear();
+   };
+
+   QString key;
+   if (!reader.enterObject()) return nullptr;
+   while (reader.nextKey(key)) {
+      if (key == "objects") {
+         if (!reader.enterArray()) break;
+         while (reader.nextElement()) {
+            scene->addLoadedObject(Object::createFromJson(reader.readValue().toObject(), *scene),
+                                   orders);
+         }
+         objectsLoaded = true;
+      } else if (key == "children") {
+         if (!reader.enterObject()) break;
+         QString parent;
+         while (reader.nextKey(parent)) {
+            const auto parentID = QUuid::fromString(parent);
+            if (!reader.enterArray()) break;
+            while (reader.nextElement()) {
+               scene->linkChild(parentID, QUuid::fromString(reader.readValue().toString()));
+            }
+         }
+      } else if (key == "components") {
+         if (!reader.enterObject()) break;
+         RawBatch batch;
+         while (reader.nextKey(batch.first)) {
+            if (!reader.enterArray()) break;
+            while (reader.nextElement()) {
+               batch.second.push_back(reader.readRaw());
+               if (batch.second.size() == ComponentBatch) flush(batch);
+            }
+            flush(batch);
+         }
+      } else if (key == "assets") {
+         (assets ? *assets : AssetProvider::instance()).read(reader, store);
+      } else {
+         reader.skipValue();
+      }
+   }
+
+   for (const auto& batch: pendingBatches) addComponents(batch);
+   if (reader.hasError() || malformed) {
+      GS_DEBUG() << "Malformed scene json";
+      return nullptr;
+   }
+
+   scene->finishLoading(orders);
+   return scene;
+}
+
+void Scene::write(JsonStreamWriter& writer, const sptr<AssetStore>& store) const {
+   // objects go first so readers can attach the components right away
+   writer.beginObject();
+   writer.key("objects");
+   writer.beginArray();
+   for (const auto& obj: m_objects) writer.value(obj->toJson());
+   writer.endArray();
+
+   writer.key("children");
+   writer.beginObject();
+   for (const auto& [parent, children]: m_children) {
+      writer.key(parent.toString());
+      writer.beginArray();
+      for (const auto& child: children) writer.value(child.toString());
+      writer.endArray();
+   }
+   writer.endObject();
+
+   writer.key("components");
+   GlobalComponentsRegistry::ToJson(m_registries, writer);
+   writer.key("assets");
+   AssetProvider::instance().write(writer, store);
+   writer.endObject();
+}
+
+uptr<Scene> Scene::createFromBinary(BinaryReader& reader, AssetProvider* assets) {
+   uptr<Scene> scene(new Scene());
+   std::function objectGetter = [scene = scene.get()](QUuid id) -> Object* {
+      return scene->findObject(id).value_or(nullptr);
+   };
+   auto& record = reader.record();
+
+   // sections are looked up by their tag, the objects have to exist before their components
+   LoadedOrders orders;
+   if (reader.beginSection(ObjectsSection)) {
+      quint64 count = 0;
+      record >> count;
+      for (quint64 i = 0; i < count && record.status() == QDataStream::Ok; ++i) {
+         scene->addLoadedObject(Object::createFromBinary(record, *scene), orders);
+      }
+   }
+
+   if (reader.beginSection(HierarchySection)) {
+      quint64 count = 0;
+      record >> count;
+      for (quint64 i = 0; i < count && record.status() == QDataStream::Ok; ++i) {
+         QUuid parent, child;
+         record >> parent >> child;
+         scene->linkChild(parent, child);
+      }
+   }
+
+   if (reader.beginSection(ComponentsSection)) {
+      GlobalComponentsRegistry::FromBinary(scene->m_registries, reader, objectGetter);
+   }
+   if (reader.beginSection(AssetsSection)) {
+      (assets ? *assets : AssetProvider::instance()).read(reader);
+   }
+
+   scene->finishLoading(orders);
+   return scene;
+}
+
+void Scene::write(BinaryWriter& writer) const {
+   // components come first, their payloads are streamed into the file while writing them
+   writer.beginSection(ComponentsSection);
+   GlobalComponentsRegistry::ToBinary(m_registries, writer);
+
+   writer.beginSection(AssetsSection);
+   AssetProvider::instance().write(writer);
+
+   writer.beginSection(ObjectsSection);
+   writer.record() << quint64(m_objects.size());
+   for (const auto& obj: m_objects) obj->write(writer.record());
+
+   writer.beginSection(HierarchySection);
+   quint64 links = 0;
+   for (const auto& [_, children]: m_children) links += children.size();
+   writer.record() << links;
+   for (const auto& [parent, children]: m_children) {
+      for (const auto& child: children) writer.record() << parent << child;
+   }
+}
+
+void Scene::loadPayloads(AssetProvider* assets) const {
+   for (const auto& registry: m_registries) {
+      if (registry) registry->loadPayloads();
+   }
+   (assets ? *assets : AssetProvider::instance()).loadPending();
+}
+
+uptr<Scene> Scene::clone() const {
+   uptr<Scene> scene(new Scene());
+   LoadedOrders orders;
+   orders.reserve(m_objects.size());
+   for (const auto& obj: m_objects) {
+      scene->addLoadedObject(Object::createFromJson(obj->toJson(), *scene), orders);
+   }
+   scene->m_children = m_children;
+   scene->m_parents = m_parents;
+
+   std::function objectGetter = [scene = scene.get()](QUuid id) -> Object* {
+      return scene->findObject(id).value_or(nullptr);
+   };
+   for (size_t i = 0; i < m_registries.size(); ++i) {
+      if (m_registries[i]) scene->m_registries[i] = m_registries[i]->clone(objectGetter);
+   }
+
+   scene->finishLoading(orders);
+   return scene;
+}
+
+void Scene::moveAllToThread(QThread* thread) {
+   // the objects aren't children of the scene, so they have to be moved one by one
+   for (auto& obj: m_objects) obj->moveToThread(thread);
+   moveToThread(thread);
+}
+
+void Scene::addLoadedObject(uptr<Object> obj, LoadedOrders& orders) {
+   orders.emplace_back(obj.get(), obj->order());
+   addObject(std::move(obj));
+}
+
+void Scene::linkChild(QUuid parent, QUuid child) {
+   m_children[parent].push_back(child);
+   m_parents[child] = parent;
+}
+
+void Scene::finishLoading(const LoadedOrders& orders) {
+   // the hierarchy has been linked directly, the stored orders are sorted in below their parents
+   m_siblings.clear();
+   for (auto [obj, order]: orders) {
+      obj->m_order = order;
+      insertOrdered(*obj, true);
+   }
+
+   // the enabled states have to be resolved once as well
+   for (auto& obj: m_objects) {
+      if (!m_parents.contains(obj->id())) obj->updateEnabled(true);
+   }
+
+   m_hierarchyChanged = true;
+   updateTransforms();
+}
+
 void Scene::addObject(uptr<Object> obj) {
    m_objects.push_back(std::move(obj));
    m_objects.back()->m_parent = this;
+   indexObject(m_objects.back().get());
+   insertOrdered(*m_objects.back(), false);
+   m_hierarchyChanged = true;
+   transformChanged(*m_objects.back());
+   objectChanged(*m_objects.back(), ChangeKind::Added);
+}
+
+void Scene::addObjects(std::vector<uptr<Object>> objs) {
+   m_objects.reserve(m_objects.size() + objs.size());
+   m_objectsById.reserve(m_objectsById.size() + objs.size());
+   for (auto& obj: objs) { addObject(std::move(obj)); }
 }
 
 void Scene::removeObject(Object& obj) {
-   for (auto* child: std::vector(obj.children())) { this->removeObject(*child); }
-   auto it = std::find_if(m_objects.begin(), m_objects.end(), [&obj](const uptr<Object>& o) {
-      return o.get() == &obj;
-   });
+   Object* objs[] = {&obj};
+   removeObjects(objs);
+}
+
+void Scene::removeObjects(std::span<Object* const> objs) {
+   // collect the objects together with all of their descendants
+   std::vector<Object*> removed;
+   std::unordered_set<Object*> removedSet;
+   for (auto* obj: objs) {
+      if (removedSet.insert(obj).second) removed.push_back(obj);
+   }
+   for (size_t i = 0; i < removed.size(); ++i) {
+      auto it = m_children.find(removed[i]->id());
+      if (it == m_children.end()) continue;
+      for (const auto& childID: it->second) {
+         if (auto child = findObject(childID); child && removedSet.insert(*child).second) {
+            removed.push_back(*child);
+         }
+      }
+   }
+
+   // unlink hierarchy and indices, only surviving parents need their child lists updated
+   for (auto* obj: removed) {
+      if (auto parent = parentOf(*obj); parent && !removedSet.contains(*parent)) {
+         removeChild(**parent, *obj);
+      }
+      eraseOrdered(*obj);
+      m_parents.erase(obj->id());
+      m_children.erase(obj->id());
+      m_siblings.erase(obj->id());
+      unindexObject(obj);
+      objectChanged(*obj, ChangeKind::Removed);
+   }
+
+   m_hierarchyChanged = true;
+
+   // drop all components, each removal is a swap-and-pop
+   for (auto& registry: m_registries) {
+      if (!registry) continue;
+      for (auto* obj: removed) { registry->erase(obj->id()); }
+   }
+   for (auto& [_, query]: m_queries) {
+      for (auto* obj: removed) { query->remove(obj->id()); }
+   }
 
-   if (it != m_objects.end()) { m_objects.erase(it); }
+   // compact the object list in a single pass
+   std::vector<uptr<Object> > graveyard;
+   graveyard.reserve(removed.size());
+   auto kept = m_objects.begin();
+   for (auto& obj: m_objects) {
+      if (removedSet.contains(obj.get())) graveyard.push_back(std::move(obj));
+      else *kept++ = std::move(obj);
+   }
+   m_objects.erase(kept, m_objects.end());
+
+   // the scene is consistent again, the objects are detached so their destructors
+   // don't have to clean up anything
+   for (auto& obj: graveyard) { obj->m_parent = nullptr; }
+   graveyard.clear();
 }
 
 std::optional<const Object*> Scene::findObject(const QString& name) const {
-   auto it = std::find_if(m_objects.begin(), m_objects.end(), [&name](const uptr<Object>& obj) {
-      return obj->name() == name;
-   });
-
-   if (it != m_objects.end()) { return it->get(); }
+   auto it = m_objectsByName.find(name);
+   if (it != m_objectsByName.end()) { return it->second.begin()->second; }
 
    return std::nullopt;
 }
 
 std::optional<Object*> Scene::findObject(const QString& name) {
-   auto it = std::find_if(m_objects.begin(), m_objects.end(), [&name](const uptr<Object>& obj) {
-      return obj->name() == name;
-   });
-
-   if (it != m_objects.end()) { return it->get(); }
+   auto it = m_objectsByName.find(name);
+   if (it != m_objectsByName.end()) { return it->second.begin()->second; }
 
    return std::nullopt;
 }
 
 std::optional<const Object*> Scene::findObject(QUuid id) const {
-   auto it = std::find_if(m_objects.begin(), m_objects.end(), [&id](const uptr<Object>& obj) {
-      return obj->id() == id;
-   });
-
-   if (it != m_objects.end()) { return it->get(); }
+   auto it = m_objectsById.find(id);
+   if (it != m_objectsById.end()) { return it->second; }
 
    return std::nullopt;
 }
 
 std::optional<Object*> Scene::findObject(QUuid id) {
-   auto it = std::ranges::find_if(m_objects, [&id](const uptr<Object>& obj) {
-      return obj && obj->id() == id;
-   });
-
-   if (it != m_objects.end()) { return it->get(); }
+   auto it = m_objectsById.find(id);
+   if (it != m_objectsById.end()) { return it->second; }
 
    return std::nullopt;
 }
 
+void Scene::indexObject(Object* obj) {
+   m_objectsById[obj->id()] = obj;
+   obj->m_sequence = m_nextSequence++;
+   m_objectsByName[obj->name()].emplace(obj->m_sequence, obj);
+}
+
+void Scene::unindexName(Object* obj, const QString& name) {
+   auto named = m_objectsByName.find(name);
+   if (named == m_objectsByName.end()) return;
+   auto& objects = named->second;
+   if (auto it = objects.find(obj->m_sequence); it != objects.end() && it->second == obj) {
+      objects.erase(it);
+   }
+   if (objects.empty()) m_objectsByName.erase(named);
+}
+
+void Scene::unindexObject(Object* obj) {
+   if (auto it = m_objectsById.find(obj->id()); it != m_objectsById.end() && it->second == obj) {
+      m_objectsById.erase(it);
+   }
+   unindexName(obj, obj->name());
+}
+
+void Scene::renameObject(Object* obj, const QString& oldName) {
+   // objects which have not been added yet are not indexed
+   auto indexed = m_objectsById.find(obj->id());
+   if (indexed == m_objectsById.end() || indexed->second != obj) return;
+
+   // the object keeps its place among the objects of the new name
+   unindexName(obj, oldName);
+   m_objectsByName[obj->name()].emplace(obj->m_sequence, obj);
+   objectChanged(*obj);
+}
+
+void Scene::reorderObject(Object* obj, uint64_t oldOrder) {
+   // objects which have not been added yet are not ordered
+   auto indexed = m_objectsById.find(obj->id());
+   if (indexed == m_objectsById.end() || indexed->second != obj) return;
+
+   const auto order = std::exchange(obj->m_order, oldOrder);
+   eraseOrdered(*obj);
+   obj->m_order = order;
+   insertOrdered(*obj, true);
+}
+
+Scene::SiblingOrder& Scene::siblingsOf(const Object& obj) {
+   auto parent = m_parents.find(obj.id());
+   return m_siblings[parent == m_parents.end() ? QUuid() : parent->second];
+}
+
+void Scene::insertOrdered(Object& obj, bool keepOrder) {
+   auto& siblings = siblingsOf(obj);
+   if (!keepOrder || siblings.contains(obj.m_order)) {
+      obj.m_order = orderAfter(siblings, siblings.empty() ? nullptr : siblings.rbegin()->second);
+   }
+   siblings.emplace(obj.m_order, &obj);
+   objectChanged(obj);
+}
+
+void Scene::eraseOrdered(const Object& obj) {
+   auto parent = m_parents.find(obj.id());
+   auto siblings = m_siblings.find(parent == m_parents.end() ? QUuid() : parent->second);
+   if (siblings == m_siblings.end()) return;
+   if (auto it = siblings->second.find(obj.m_order);
+       it != siblings->second.end() && it->second == &obj) {
+      siblings->second.erase(it);
+   }
+}
+
+uint64_t Scene::orderAfter(SiblingOrder& siblings, const Object* previous) {
+   while (true) {
+      auto next = previous ? siblings.upper_bound(previous->m_order) : siblings.begin();
+      if (next == siblings.end()) {
+         if (!previous) return OrderGap;
+         if (previous->m_order <= std::numeric_limits<uint64_t>::max() - OrderGap) {
+            return previous->m_order + OrderGap;
+         }
+      } else {
+         // smallest key after previous, the new key lies halfway to the next sibling
+         const uint64_t lower = previous ? previous->m_order + 1 : 0;
+         if (next->first > lower) return lower + (next->first - lower) / 2;
+      }
+
+      // the neighbours are adjacent, only this parent's children are spread out again
+      renumber(siblings);
+   }
+}
+
+void Scene::renumber(SiblingOrder& siblings) {
+   SiblingOrder renumbered;
+   uint64_t order = 0;
+   for (auto [_, obj]: siblings) {
+      obj->m_order = order += OrderGap;
+      renumbered.emplace_hint(renumbered.end(), order, obj);
+      if (auto* scene = obj->scene()) scene->objectChanged(*obj);
+   }
+   siblings.swap(renumbered);
+}
+
+std::vector<Object*> Scene::orderedChildrenOf(const Object* parent) const {
+   std::vector<Object*> children;
+   auto it = m_siblings.find(parent ? parent->id() : QUuid());
+   if (it == m_siblings.end()) return children;
+   children.reserve(it->second.size());
+   for (auto [_, child]: it->second) children.push_back(child);
+   return children;
+}
+
+void Scene::placeAfter(Object& obj, const Object* previous) {
+   if (previous == &obj) return;
+   eraseOrdered(obj);
+   auto& siblings = siblingsOf(obj);
+   obj.m_order = orderAfter(siblings, previous);
+   siblings.emplace(obj.m_order, &obj);
+   objectChanged(obj);
+}
+
 std::vector<const Object*> Scene::objects() const {
    std::vector<const Object*> objs;
    for (const auto& obj: m_objects) { objs.push_back(obj.get()); }
@@ -163,67 +538,377 @@ std::vector<Object*> Scene::objects() {
 }
 
 void Scene::unregister(Object* obj) {
-   auto getter = [this](QString name) {
-      if (m_componentsRegistrar.find(name) == m_componentsRegistrar.end()) { return sptr<void>(); }
-      return m_componentsRegistrar.at(name);
+   for (auto& registry: m_registries) {
+      if (registry) { registry->erase(obj->id()); }
+   }
+   for (auto& [_, query]: m_queries) { query->remove(obj->id()); }
+   eraseOrdered(*obj);
+   m_hierarchyChanged = true;
+   objectChanged(*obj, ChangeKind::Removed);
+}
+
+void Scene::componentModified(Object* obj, size_t typeIndex) {
+   if (typeIndex == ComponentTypeIndex<TransformComponent>) transformChanged(*obj);
+   if (auto& registry = m_registries[typeIndex]) {
+      registry->journal().record(obj->id(), ChangeKind::Modified);
+   }
+   objectChanged(*obj);
+}
+
+void Scene::componentsChanged(Object* obj, size_t typeIndex) {
+   objectChanged(*obj);
+   for (auto& [_, query]: m_queries) {
+      if (query->mask.test(typeIndex)) { query->refresh(obj); }
+   }
+}
+
+void Scene::transformChanged(const Object& obj) {
+   m_dirtyTransforms.insert(obj.id());
+}
+
+void Scene::childTransformsChanged(const Object& obj) {
+   auto it = m_children.find(obj.id());
+   if (it == m_children.end()) return;
+   for (const auto& childID: it->second) {
+      auto child = findObject(childID);
+      if (!child) continue;
+      if (hasComponent<TransformComponent>(*child)) transformChanged(**child);
+      else childTransformsChanged(**child);
+   }
+}
+
+void Scene::objectChanged(const Object& obj, ChangeKind kind) {
+   m_objectChanges.record(obj.id(), kind);
+}
+
+ChangeJournal::Subscription Scene::subscribeObjects() { return m_objectChanges.subscribe(); }
+
+void Scene::unsubscribeObjects(ChangeJournal::Subscription subscription) {
+   m_objectChanges.unsubscribe(subscription);
+}
+
+ChangeSet Scene::drainObjectChanges(ChangeJournal::Subscription subscription) {
+   return m_objectChanges.drain(subscription);
+}
+
+bool Scene::hasObjectChanges(ChangeJournal::Subscription subscription) const {
+   return m_objectChanges.hasPending(subscription);
+}
+
+QJsonObject Scene::objectDelta(const Object& obj) const {
+   QJsonObject components;
+   for (const auto& registry: m_registries) {
+      if (registry && registry->contains(obj.id())) {
+         components[registry->name()] = registry->componentJson(obj.id());
+      }
+   }
+
+   QJsonObject delta;
+   delta["object"] = obj.toJson();
+   const auto parent = m_parents.find(obj.id());
+   delta["parent"] = parent == m_parents.end() ? QString() : parent->second.toString();
+   delta["components"] = components;
+   return delta;
+}
+
+void Scene::applyDeltas(std::span<const QJsonObject> deltas, std::span<const QUuid> removed) {
+   std::function objectGetter = [this](QUuid id) -> Object* {
+      return findObject(id).value_or(nullptr);
    };
-   for (auto& deletor: GlobalComponentsRegistry::Deletors()) { deletor(getter, obj->id()); }
+
+   // objects are created or updated first, their components are replaced as a whole
+   std::vector<std::pair<Object*, QUuid>> parents;
+   std::unordered_map<Object*, uint64_t> orders;
+   for (const auto& delta: deltas) {
+      const auto json = delta["object"].toObject();
+      const auto id = QUuid::fromString(json["id"].toString());
+      Object* obj = findObject(id).value_or(nullptr);
+      if (obj) {
+         obj->setName(json["name"].toString());
+         obj->m_enabled = json["enabled"].toBool(true);
+      } else {
+         addObject(Object::createFromJson(json, *this));
+         obj = m_objects.back().get();
+      }
+      orders[obj] = json["order"].toString().toULongLong();
+      parents.emplace_back(obj, QUuid::fromString(delta["parent"].toString()));
+
+      for (auto& registry: m_registries) {
+         if (registry) registry->erase(id);
+      }
+      const auto components = delta["components"].toObject();
+      for (auto it = components.begin(); it != components.end(); ++it) {
+         const QJsonObject element[] = {{{"id", id.toString()}, {"data", it.value()}}};
+         GlobalComponentsRegistry::FromJson(m_registries, it.key(), element, objectGetter);
+      }
+      for (auto& [_, query]: m_queries) query->refresh(obj);
+      transformChanged(*obj);
+   }
+
+   // then they are moved below their parents, which all exist by now
+   for (auto [obj, parent]: parents) {
+      const auto oldParent = m_parents.find(obj->id());
+      if (oldParent != m_parents.end()) {
+         if (oldParent->second == parent) continue;
+         std::erase(m_children[oldParent->second], obj->id());
+         m_parents.erase(oldParent);
+      }
+      if (!parent.isNull()) linkChild(parent, obj->id());
+   }
+
+   std::vector<Object*> removedObjects;
+   for (const auto& id: removed) {
+      if (auto obj = findObject(id)) removedObjects.push_back(*obj);
+   }
+   removeObjects(removedObjects);
+
+   // all siblings are ordered from scratch with the stored orders
+   LoadedOrders allOrders;
+   allOrders.reserve(m_objects.size());
+   for (auto& obj: m_objects) {
+      auto order = orders.find(obj.get());
+      allOrders.emplace_back(obj.get(), order == orders.end() ? obj->m_order : order->second);
+   }
+   finishLoading(allOrders);
+}
+
+void Scene::updateTransforms() {
+   if (m_dirtyTransforms.empty() && !m_hierarchyChanged) return;
+   if (m_hierarchyChanged) rebuildHierarchy();
+
+   const auto& [handles, parents, levels, index] = m_hierarchy;
+   auto& transforms = registry<TransformComponent>();
+
+   // 1 = changed itself, 2 = recomputed, children of recomputed transforms are recomputed too
+   std::vector<uint8_t> state(handles.size(), 0);
+   for (const auto& id: m_dirtyTransforms) {
+      if (auto it = index.find(id); it != index.end()) state[it->second] = 1;
+   }
+   m_dirtyTransforms.clear();
+
+   auto& jobs = JobSystem::instance();
+   for (size_t level = 0; level + 1 < levels.size(); ++level) {
+      const auto first = levels[level];
+      jobs.parallelFor(levels[level + 1] - first, 512, [&](size_t begin, size_t end) {
+         // the local matrices of a chunk are composed in one batch
+         std::vector<size_t> changed;
+         for (auto i = first + begin; i < first + end; ++i) {
+            if (state[i] == 1 || (parents[i] >= 0 && state[parents[i]] == 2)) changed.push_back(i);
+         }
+         if (changed.empty()) return;
+
+         TransformMath::TrsArrays trs;
+         trs.resize(changed.size());
+         for (size_t k = 0; k < changed.size(); ++k) {
+            const auto* transform = transforms.get(handles[changed[k]]);
+            trs.set(k, transform->position, transform->rotation, transform->scale);
+         }
+         std::vector<QMatrix4x4> locals(changed.size());
+         TransformMath::composeTRS(trs, locals.data());
+
+         for (size_t k = 0; k < changed.size(); ++k) {
+            const auto i = changed[k];
+            auto* transform = transforms.get(handles[i]);
+            transform->m_world = parents[i] >= 0
+                                    ? transforms.get(handles[parents[i]])->m_world * locals[k]
+                                    : locals[k];
+            state[i] = 2;
+         }
+      });
+   }
+}
+
+void Scene::rebuildHierarchy() {
+   auto& [handles, parents, levels, index] = m_hierarchy;
+   handles.clear();
+   parents.clear();
+   levels.clear();
+   index.clear();
+   auto& transforms = registry<TransformComponent>();
+
+   // breadth first, so every level is one contiguous range; objects without a transform
+   // are skipped and their children become roots like before
+   std::vector<std::pair<Object*, int64_t> > current, next;
+   for (const auto& obj: m_objects) {
+      if (!m_parents.contains(obj->id())) current.emplace_back(obj.get(), -1);
+   }
+
+   while (!current.empty()) {
+      levels.push_back(handles.size());
+      for (auto [obj, parent]: current) {
+         int64_t self = -1;
+         if (auto handle = transforms.handle(obj->id()); handle.valid()) {
+            self = static_cast<int64_t>(handles.size());
+            index.emplace(obj->id(), handles.size());
+            handles.push_back(handle);
+            parents.push_back(parent);
+         }
+
+         auto it = m_children.find(obj->id());
+         if (it == m_children.end()) continue;
+         for (const auto& childID: it->second) {
+            if (auto child = findObject(childID)) next.emplace_back(*child, self);
+         }
+      }
+      current.swap(next);
+      next.clear();
+   }
+   levels.push_back(handles.size());
+   m_hierarchyChanged = false;
 }
 
 Scene::~Scene() {
    // first clear objects !!!
+   // they are detached up front since the whole scene is going away anyway
    std::vector<uptr<Object> > tmp;
    m_objects.swap(tmp);
+   m_objectsById.clear();
+   m_objectsByName.clear();
+   for (auto& obj: tmp) { obj->m_parent = nullptr; }
    tmp.clear();
 
    // only afterwards clear registry!!!
-   m_componentsRegistrar.clear();
+   for (auto& registry: m_registries) { registry.reset(); }
 }
 
 Object& Scene::copyObject(const Object& obj) {
-   // intentionally without this parameter to avoid creating a transform component
+   // intentionally without Object::create to avoid creating a transform component
    // since we manually copy each component later
-   auto newObj = Object::create(*this);
-   newObj->m_id = QUuid::createUuid();
+   auto newObj = uptr<Object>(new Object());
+   newObj->m_parent = this;
    newObj->setName(obj.name() + " (copy)");
    newObj->enable(obj.enabled());
    auto id = newObj->m_id;
 
    for (auto& [name, copier]: GlobalComponentsRegistry::Copiers()) {
-      if (!m_componentsRegistrar.contains(name)) continue;
-
-      auto compReg = m_componentsRegistrar.at(name);
-      copier(&obj, newObj.get(), compReg);
+      copier(&obj, newObj.get(), m_registries);
    }
 
    addObject(std::move(newObj));
-   return *findObject(id).value();
+   auto* copy = findObject(id).value();
+   for (auto& [_, query]: m_queries) { query->refresh(copy); }
+   return *copy;
 }
 
 void Scene::addChild(Object& parent, Object& child) {
    if (auto oldParent = parentOf(child)) removeChild(**oldParent, child);
 
+   eraseOrdered(child);
    m_children[parent.id()].push_back(child.id());
+   m_parents[child.id()] = parent.id();
+   insertOrdered(child, false);
+   child.updateEnabled();
+   m_hierarchyChanged = true;
+   transformChanged(child);
 }
 
 void Scene::removeChild(Object& parent, Object& child) {
-   auto iter = std::ranges::find(m_children[parent.id()], child.id());
-   if (iter != m_children[parent.id()].end()) { m_children[parent.id()].erase(iter); }
+   auto children = m_children.find(parent.id());
+   if (children == m_children.end()) return;
+
+   auto iter = std::ranges::find(children->second, child.id());
+   if (iter == children->second.end()) return;
+
+   children->second.erase(iter);
+   eraseOrdered(child);
+   m_parents.erase(child.id());
+   insertOrdered(child, false);
+   child.updateEnabled();
+   m_hierarchyChanged = true;
+   transformChanged(child);
+}
+
+bool Scene::reparent(std::span<Object* const> objs, Object* newParent, bool keepWorld) {
+   std::unordered_set<QUuid, QtHasher<QUuid>> moved;
+   for (auto* obj: objs) moved.insert(obj->id());
+
+   // a cycle would be created if the new parent is one of the objects or any of their children
+   for (auto id = newParent ? std::optional(newParent->id()) : std::nullopt; id;) {
+      if (moved.contains(*id)) return false;
+      auto parent = m_parents.find(*id);
+      id = parent == m_parents.end() ? std::nullopt : std::optional(parent->second);
+   }
+
+   // only the topmost moved objects change their parent, the others move along with them
+   std::vector<Object*> roots;
+   roots.reserve(objs.size());
+   for (auto* obj: objs) {
+      bool nested = false;
+      for (auto parent = m_parents.find(obj->id()); parent != m_parents.end() && !nested;
+           parent = m_parents.find(parent->second)) {
+         nested = moved.contains(parent->second);
+      }
+      if (!nested) roots.push_back(obj);
+   }
+   if (roots.empty()) return true;
+
+   // world matrices are taken before anything moves, all of them are decomposed in one batch
+   std::vector<TransformComponent*> transforms;
+   std::vector<QMatrix4x4> locals;
+   if (keepWorld) {
+      updateTransforms();
+      auto* parentTransform = newParent ? findComponent<TransformComponent>(newParent) : nullptr;
+      const auto parentInverse = parentTransform
+                                    ? TransformMath::inverseAffine(parentTransform->modelMatrix())
+                                    : QMatrix4x4();
+      for (auto* obj: roots) {
+         if (auto* transform = findComponent<TransformComponent>(obj)) {
+            transforms.push_back(transform);
+            locals.push_back(parentInverse * transform->modelMatrix());
+         }
+      }
+   }
+
+   std::unordered_set<QUuid, QtHasher<QUuid>> oldParents;
+   for (auto* obj: roots) {
+      if (auto parent = m_parents.find(obj->id()); parent != m_parents.end()) {
+         oldParents.insert(parent->second);
+      }
+   }
+   for (const auto& parent: oldParents) {
+      std::erase_if(m_children[parent], [&](const QUuid& child) { return moved.contains(child); });
+   }
+
+   for (auto* obj: roots) {
+      eraseOrdered(*obj);
+      if (newParent) {
+         m_children[newParent->id()].push_back(obj->id());
+         m_parents[obj->id()] = newParent->id();
+      } else {
+         m_parents.erase(obj->id());
+      }
+      insertOrdered(*obj, false);
+      obj->updateEnabled();
+      transformChanged(*obj);
+   }
+   m_hierarchyChanged = true;
+
+   if (keepWorld && !transforms.empty()) {
+      TransformMath::TrsArrays trs;
+      TransformMath::decompose(locals.data(), locals.size(), trs);
+      for (size_t i = 0; i < transforms.size(); ++i) {
+         transforms[i]->position = QVector3D(trs.px[i], trs.py[i], trs.pz[i]);
+         transforms[i]->rotation = QQuaternion(trs.rw[i], trs.rx[i], trs.ry[i], trs.rz[i]);
+         transforms[i]->scale = QVector3D(trs.sx[i], trs.sy[i], trs.sz[i]);
+         transforms[i]->dirty();
+      }
+   }
+   updateTransforms();
+   return true;
 }
 
 std::optional<Object*> Scene::parentOf(const Object& child) {
-   auto it = std::ranges::find_if(m_children, [&child](const auto& pair) {
-      return std::ranges::find(pair.second, child.id()) != pair.second.end();
-   });
-   if (it == m_children.end()) return std::nullopt;
-   auto id = it->first;
-   return findObject(id);
+   auto it = m_parents.find(child.id());
+   if (it == m_parents.end()) return std::nullopt;
+   return findObject(it->second);
 }
 
 std::vector<Object*> Scene::childrenOf(const Object& parent) {
    std::vector<Object*> children;
-   if (m_children.find(parent.id()) == m_children.end()) return children;
-   for (const auto& id: m_children[parent.id()]) {
+   auto it = m_children.find(parent.id());
+   if (it == m_children.end()) return children;
+   children.reserve(it->second.size());
+   for (const auto& id: it->second) {
       if (auto child = findObject(id)) { children.push_back(child.value()); }
    }
    return children;
@@ -4,32 +4,71 @@
 #include "Model/Components/TransformComponent.h"
 #include <QJsonObject>
 #include <QObject>
+#include <map>
 #include <memory>
+#include <span>
 #include <vector>
 #include "Model/Components/ComponentsRegistry.h"
+#include "SceneQuery.h"
+#include <typeindex>
+#include <unordered_set>
 
 class Object;
 class TransformComponent;
+class AssetStore;
+class AssetProvider;
 
 class Scene : public QObject, public std::enable_shared_from_this<Scene> {
    Q_OBJECT
 
 public:
+   friend class Object;
+
    ~Scene();
 
    static uptr<Scene> createEmpty();
    static uptr<Scene> createFromJson(const QJsonObject& json);
    QJsonObject toJson() const;
+   /// Same json layout, but read and written element by element instead of as one document.
+   /// With a store the assets live in it and the scene only references them. Loaded assets go
+   /// into the given provider, the global one if it is null.
+   static uptr<Scene> createFromJson(JsonStreamReader& reader,
+                                     const sptr<AssetStore>& store = nullptr,
+                                     AssetProvider* assets = nullptr);
+   void write(JsonStreamWriter& writer, const sptr<AssetStore>& store = nullptr) const;
+   static uptr<Scene> createFromBinary(BinaryReader& reader, AssetProvider* assets = nullptr);
+   void write(BinaryWriter& writer) const;
+   /// Large mesh payloads and the pending assets of the provider the scene was loaded into are
+   /// only decoded when they are first used, this loads all of them at once on the job system
+   void loadPayloads(AssetProvider* assets = nullptr) const;
+
+   /// Copy of the objects, hierarchy and components which can be saved on another thread while
+   /// this scene keeps changing. Mesh streams are shared with the copy until either side edits them.
+   uptr<Scene> clone() const;
+   /// Moves the scene and its objects to thread, called on the thread which built the scene
+   void moveAllToThread(QThread* thread);
 
    void addObject(uptr<Object> obj);
+   void addObjects(std::vector<uptr<Object>> objs);
    void removeObject(Object& obj);
+   void removeObjects(std::span<Object* const> objs);
    Object& copyObject(const Object& obj);
 
    void addChild(Object& parent, Object& child);
    void removeChild(Object& parent, Object& child);
+   /// Moves all objects below newParent (or to the root if it is null) in one pass. Objects whose
+   /// ancestor is moved as well keep their place in its subtree. With keepWorld the local
+   /// transforms are adjusted so the objects stay where they are in the world.
+   /// Returns false and changes nothing if newParent is one of the objects or below one of them.
+   bool reparent(std::span<Object* const> objs, Object* newParent, bool keepWorld);
    std::optional<Object*> parentOf(const Object& child);
    std::vector<Object*> childrenOf(const Object& parent);
    std::vector<Object*> allChildrenOf(const Object& parent);
+   /// Children of parent sorted by their order, the root objects if parent is null
+   std::vector<Object*> orderedChildrenOf(const Object* parent) const;
+   /// Moves obj directly behind previous among its siblings, to the front if previous is null.
+   /// Only obj gets a new order unless there is no key left between its new neighbours.
+   void placeAfter(Object& obj, const Object* previous);
 
    std::optional<const Object*> findObject(const QString& name) const;
    std::optional<Object*> findObject(const QString& name);
@@ -44,11 +83,34 @@ public:
    template <typename T> T& addComponent(Object* obj);
    template <typename T> void removeComponent(Object* obj);
    template <typename T> bool hasComponent(const Object* obj);
+   template <typename T> T* findComponent(const Object* obj);
+
+   template <typename T> ComponentsRegistry<T>& components();
+   template <typename... Ts> ComponentsView<Ts...> view();
+   template <typename... Ts> ComponentsQuery<Ts...>& query();
+
+   template <typename T> ChangeJournal::Subscription subscribe();
+   template <typename T> void unsubscribe(ChangeJournal::Subscription subscription);
+   template <typename T> ChangeSet drainChanges(ChangeJournal::Subscription subscription);
 
-   template <typename T> std::unordered_map<QUuid, T, QtHasher<QUuid>>& components();
+   /// Journal of the objects which were added, removed or changed in any way since the last
+   /// drain, including their components, parents and orders
+   ChangeJournal::Subscription subscribeObjects();
+   void unsubscribeObjects(ChangeJournal::Subscription subscription);
+   ChangeSet drainObjectChanges(ChangeJournal::Subscription subscription);
+   bool hasObjectChanges(ChangeJournal::Subscription subscription) const;
+
+   /// Complete state of one object for incremental saves: its json, parent and components
+   QJsonObject objectDelta(const Object& obj) const;
+   /// Brings the scene to the state described by the deltas, removed objects go last
+   void applyDeltas(std::span<const QJsonObject> deltas, std::span<const QUuid> removed);
 
    void unregister(Object* obj);
 
+   /// Recomputes the cached world matrices of all transforms whose local transform or parent
+   /// changed, parents before their children
+   void updateTransforms();
+
 signals:
    void objectAdded(const Object& obj);
    void objectRemoved(const Object& obj);
@@ -57,10 +119,63 @@ signals:
 private:
    Scene() = default;
 
+   void indexObject(Object* obj);
+   void unindexObject(Object* obj);
+   void unindexName(Object* obj, const QString& name);
+   void renameObject(Object* obj, const QString& oldName);
+   void reorderObject(Object* obj, uint64_t oldOrder);
+
+   using SiblingOrder = std::map<uint64_t, Object*>;
+   SiblingOrder& siblingsOf(const Object& obj);
+   void insertOrdered(Object& obj, bool keepOrder);
+   void eraseOrdered(const Object& obj);
+   uint64_t orderAfter(SiblingOrder& siblings, const Object* previous);
+   static void renumber(SiblingOrder& siblings);
+
+   template <typename T> ComponentsRegistry<T>& registry();
+   template <typename T> ComponentsRegistry<T>* findRegistry() const;
+   void componentsChanged(Object* obj, size_t typeIndex);
+   void componentModified(Object* obj, size_t typeIndex);
+   void transformChanged(const Object& obj);
+   /// Marks the nearest transforms below obj, objects without one are looked through
+   void childTransformsChanged(const Object& obj);
+   void objectChanged(const Object& obj, ChangeKind kind = ChangeKind::Modified);
+   void rebuildHierarchy();
+
+   /// Objects are added before their hierarchy is known, their stored orders are applied at the end
+   using LoadedOrders = std::vector<std::pair<Object*, uint64_t>>;
+   void addLoadedObject(uptr<Object> obj, LoadedOrders& orders);
+   void linkChild(QUuid parent, QUuid child);
+   void finishLoading(const LoadedOrders& orders);
+
 private:
    std::vector<uptr<Object>> m_objects;
-   std::unordered_map<QString, sptr<void>, QtHasher<QString>> m_componentsRegistrar;
+   std::unordered_map<QUuid, Object*, QtHasher<QUuid>> m_objectsById;
+   // objects sharing a name are kept in the order they were added, findObject returns the first
+   std::unordered_map<QString, std::map<uint64_t, Object*>, QtHasher<QString>> m_objectsByName;
+   uint64_t m_nextSequence = 0;
+   ComponentsRegistries m_registries;
+   std::unordered_map<std::type_index, uptr<ComponentsQueryBase>> m_queries;
    std::unordered_map<QUuid, std::vector<QUuid>, QtHasher<QUuid>> m_children;
+   std::unordered_map<QUuid, QUuid, QtHasher<QUuid>> m_parents;
+   std::unordered_set<QUuid, QtHasher<QUuid>> m_dirtyTransforms;
+   ChangeJournal m_objectChanges;
+
+   /// Order keys are only unique among siblings and sparse, so an object can be moved between
+   /// two others without touching them. Keyed by the parent's id, QUuid() for the roots.
+   std::unordered_map<QUuid, SiblingOrder, QtHasher<QUuid>> m_siblings;
+   static constexpr uint64_t OrderGap = uint64_t(1) << 32;
+
+   /// All objects flattened and sorted by depth, rebuilt whenever the hierarchy or the set of
+   /// transforms changes. Every level only depends on the one before, so a level is updated in parallel.
+   struct FlatHierarchy {
+      std::vector<ComponentHandle> transforms;
+      std::vector<int64_t> parents;// index of the parent's transform, -1 for roots
+      std::vector<size_t> levels;  // first index of every depth level plus the end
+      std::unordered_map<QUuid, size_t, QtHasher<QUuid>> index;
+   };
+   FlatHierarchy m_hierarchy;
+   bool m_hierarchyChanged = true;
 };
 
 template<typename T>
@@ -89,68 +204,99 @@ bool Object::hasComponent() const {
 }
 
 template<typename T>
-T& Scene::getComponent(Object* obj) {
-   auto name = T::Name;
-   if (!m_componentsRegistrar.contains(name)) {
-      m_componentsRegistrar[name] = std::make_shared<ComponentsRegistry<T>>();
-   }
+ComponentsRegistry<T>& Scene::registry() {
+   auto& registry = m_registries[ComponentTypeIndex<T>];
+   if (!registry) { registry = std::make_shared<ComponentsRegistry<T>>(); }
+   return static_cast<ComponentsRegistry<T>&>(*registry);
+}
 
-   auto registry = std::static_pointer_cast<ComponentsRegistry<T>>(m_componentsRegistrar.at(name));
-   return registry->components().at(obj->id());
+template<typename T>
+ComponentsRegistry<T>* Scene::findRegistry() const {
+   return static_cast<ComponentsRegistry<T>*>(m_registries[ComponentTypeIndex<T>].get());
 }
 
 template<typename T>
-const T& Scene::getComponent(const Object* obj) {
-   auto name = T::Name;
-   if (!m_componentsRegistrar.contains(name)) {
-      m_componentsRegistrar[name] = std::make_shared<ComponentsRegistry<T>>();
-   }
+T& Scene::getComponent(Object* obj) {
+   return registry<T>().at(obj->id());
+}
 
-   auto registry = std::static_pointer_cast<ComponentsRegistry<T>>(m_componentsRegistrar.at(name));
-   return registry->components().at(obj->id());
+template<typename T>
+const T& Scene::getComponent(const Object* obj) {
+   return registry<T>().at(obj->id());
 }
 
 template<typename T>
 T& Scene::addComponent(Object* obj) {
-   auto name = T::Name;
-   if (!m_componentsRegistrar.contains(name)) {
-      m_componentsRegistrar[name] = std::make_shared<ComponentsRegistry<T>>();
+   auto& component = registry<T>().emplace(obj->id(), obj);
+   componentsChanged(obj, ComponentTypeIndex<T>);
+   if constexpr (std::is_same_v<T, TransformComponent>) {
+      m_hierarchyChanged = true;
+      transformChanged(*obj);
    }
-
-   auto registry = std::static_pointer_cast<ComponentsRegistry<T>>(m_componentsRegistrar.at(name));
-   return registry->components().emplace(obj->id(), obj).first->second;
+   return component;
 }
 
 template<typename T>
 void Scene::removeComponent(Object* obj) {
-   auto name = T::Name;
-   if (!m_componentsRegistrar.contains(name)) {
-      return;
+   if (auto* registry = findRegistry<T>()) {
+      registry->erase(obj->id());
+      componentsChanged(obj, ComponentTypeIndex<T>);
+      if constexpr (std::is_same_v<T, TransformComponent>) {
+         // the children are roots now, their world matrices still have this one in them
+         m_hierarchyChanged = true;
+         childTransformsChanged(*obj);
+      }
    }
-
-   auto registry = std::static_pointer_cast<ComponentsRegistry<T>>(m_componentsRegistrar.at(name));
-   registry->components().erase(obj->id());
 }
 
 template<typename T>
 bool Scene::hasComponent(const Object* obj) {
-   auto name = T::Name;
-   if (!m_componentsRegistrar.contains(name)) {
-      return false;
-   }
+   auto* registry = findRegistry<T>();
+   return registry && registry->contains(obj->id());
+}
 
-   auto registry = std::static_pointer_cast<ComponentsRegistry<T>>(m_componentsRegistrar.at(name));
-   return registry->components().contains(obj->id());
+template<typename T>
+T* Scene::findComponent(const Object* obj) {
+   auto* registry = findRegistry<T>();
+   return registry ? registry->find(obj->id()) : nullptr;
 }
 
 template <typename T>
-std::unordered_map<QUuid, T, QtHasher<QUuid>>& Scene::components() {
-   auto name = T::Name;
-   if (!m_componentsRegistrar.contains(name)) {
-      m_componentsRegistrar[name] = std::make_shared<ComponentsRegistry<T>>();
+ComponentsRegistry<T>& Scene::components() {
+   return registry<T>();
+}
+
+template <typename... Ts>
+ComponentsView<Ts...> Scene::view() {
+   return ComponentsView<Ts...>(std::tuple(findRegistry<Ts>()...));
+}
+
+template <typename... Ts>
+ComponentsQuery<Ts...>& Scene::query() {
+   // existing queries are only looked up, so systems running in parallel may share them
+   const auto key = std::type_index(typeid(ComponentsQuery<Ts...>));
+   if (auto it = m_queries.find(key); it != m_queries.end()) {
+      return static_cast<ComponentsQuery<Ts...>&>(*it->second);
    }
 
-   auto registry = std::static_pointer_cast<ComponentsRegistry<T>>(m_componentsRegistrar.at(name));
-   return registry->components();
+   auto created = std::make_unique<ComponentsQuery<Ts...>>(std::tuple(&registry<Ts>()...));
+   for (auto components: view<Ts...>()) { created->refresh(&std::get<0>(components).parent()); }
+   auto& query = *created;
+   m_queries.emplace(key, std::move(created));
+   return query;
 }
 
+template <typename T>
+ChangeJournal::Subscription Scene::subscribe() {
+   return registry<T>().journal().subscribe();
+}
+
+template <typename T>
+void Scene::unsubscribe(ChangeJournal::Subscription subscription) {
+   if (auto* registry = findRegistry<T>()) { registry->journal().unsubscribe(subscription); }
+}
+
+template <typename T>
+ChangeSet Scene::drainChanges(ChangeJournal::Subscription subscription) {
+   return registry<T>().journal().drain(subscription);
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include "Model/Components/ComponentsRegistry.h"
+#include <algorithm>
+#include <bitset>
+#include <tuple>
+#include <utility>
+
+using ComponentsMask = std::bitset<ComponentTypeCount>;
+
+template<typename... Ts>
+ComponentsMask componentsMask() {
+   ComponentsMask mask;
+   (mask.set(ComponentTypeIndex<Ts>), ...);
+   return mask;
+}
+
+/// Uncached iteration over all objects which have every component in Ts.
+/// Walks the smallest of the involved registries and looks the remaining components up by id.
+template<typename... Ts>
+class ComponentsView {
+public:
+   using registries_t = std::tuple<ComponentsRegistry<Ts>*...>;
+   using value_type = std::tuple<Ts&...>;
+
+   explicit ComponentsView(registries_t registries) : m_registries(registries) {
+      const bool complete = ((std::get<ComponentsRegistry<Ts>*>(m_registries) != nullptr) && ...);
+      if (!complete) return;
+
+      std::apply([this](auto*... registry) {
+         ((m_ids = (!m_ids || registry->size() < m_ids->size()) ? &registry->ids() : m_ids), ...);
+      }, m_registries);
+   }
+
+   class iterator {
+   public:
+      iterator(const ComponentsView* view, size_t index) : m_view(view), m_index(index) { skip(); }
+
+      value_type operator*() const {
+         return std::apply([](auto*... component) { return value_type(*component...); }, m_current);
+      }
+
+      iterator& operator++() {
+         ++m_index;
+         skip();
+         return *this;
+      }
+
+      bool operator==(const iterator& other) const { return m_index == other.m_index; }
+
+   private:
+      void skip() {
+         while (m_index < m_view->count()) {
+            const auto& id = (*m_view->m_ids)[m_index];
+            m_current = std::tuple(std::get<ComponentsRegistry<Ts>*>(m_view->m_registries)->find(id)...);
+            const bool matches = std::apply([](auto*... component) {
+               return ((component != nullptr) && ...);
+            }, m_current);
+            if (matches) return;
+            ++m_index;
+         }
+      }
+
+      const ComponentsView* m_view;
+      size_t m_index;
+      std::tuple<Ts*...> m_current;
+   };
+
+   iterator begin() const { return iterator(this, 0); }
+   iterator end() const { return iterator(this, count()); }
+
+private:
+   size_t count() const { return m_ids ? m_ids->size() : 0; }
+
+   registries_t m_registries;
+   const std::vector<QUuid>* m_ids = nullptr;
+};
+
+/// Type erased part of a cached query, the scene notifies it whenever components change
+struct ComponentsQueryBase {
+   virtual ~ComponentsQueryBase() = default;
+   virtual void refresh(Object* obj) = 0;
+   virtual void remove(QUuid id) = 0;
+
+   ComponentsMask mask;
+};
+
+/// Cached list of all objects which have every component in Ts. The scene keeps it up to date
+/// incrementally, iterating it only resolves component handles and never hashes an id.
+template<typename... Ts>
+class ComponentsQuery final : public ComponentsQueryBase {
+public:
+   using registries_t = std::tuple<ComponentsRegistry<Ts>*...>;
+   using value_type = std::tuple<Ts&...>;
+
+   struct Entry {
+      Object* object;
+      std::array<ComponentHandle, sizeof...(Ts)> handles;
+   };
+
+   explicit ComponentsQuery(registries_t registries) : m_registries(registries) {
+      mask = componentsMask<Ts...>();
+   }
+
+   void refresh(Object* obj) override {
+      const std::array<ComponentHandle, sizeof...(Ts)> handles{
+         std::get<ComponentsRegistry<Ts>*>(m_registries)->handle(obj->id())...
+      };
+      const bool matches = std::ranges::all_of(handles, &ComponentHandle::valid);
+
+      auto it = m_index.find(obj->id());
+      if (!matches) {
+         if (it != m_index.end()) remove(obj->id());
+         return;
+      }
+
+      if (it != m_index.end()) {
+         m_entries[it->second].handles = handles;
+         return;
+      }
+
+      m_index.emplace(obj->id(), m_entries.size());
+      m_entries.push_back({obj, handles});
+   }
+
+   void remove(QUuid id) override {
+      auto it = m_index.find(id);
+      if (it == m_index.end()) return;
+
+      const auto index = it->second;
+      m_index.erase(it);
+      if (index != m_entries.size() - 1) {
+         m_entries[index] = m_entries.back();
+         m_index[m_entries[index].object->id()] = index;
+      }
+      m_entries.pop_back();
+   }
+
+   const std::vector<Entry>& entries() const { return m_entries; }
+   size_t size() const { return m_entries.size(); }
+
+   value_type resolve(const Entry& entry) const {
+      return resolve(entry, std::index_sequence_for<Ts...>());
+   }
+
+   class iterator {
+   public:
+      iterator(const ComponentsQuery* query, size_t index) : m_query(query), m_index(index) {}
+
+      value_type operator*() const { return m_query->resolve(m_query->m_entries[m_index]); }
+
+      iterator& operator++() {
+         ++m_index;
+         return *this;
+      }
+
+      bool operator==(const iterator& other) const { return m_index == other.m_index; }
+
+   private:
+      const ComponentsQuery* m_query;
+      size_t m_index;
+   };
+
+   iterator begin() const { return iterator(this, 0); }
+   iterator end() const { return iterator(this, m_entries.size()); }
+
+private:
+   template<size_t... Is>
+   value_type resolve(const Entry& entry, std::index_sequence<Is...>) const {
+      return value_type(*std::get<Is>(m_registries)->get(entry.handles[Is])...);
+   }
+
+   registries_t m_registries;
+   std::vector<Entry> m_entries;
+   std::unordered_map<QUuid, size_t, QtHasher<QUuid> > m_index;
+};
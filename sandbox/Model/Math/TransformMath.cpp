@@ -0,0 +1,356 @@
+#include "TransformMath.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#define GS_TRANSFORM_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GS_TRANSFORM_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+   using namespace TransformMath;
+
+   // all kernels write the matrices column-major, dst(i) returns where matrix i goes
+
+   void composeOne(float* m, float px, float py, float pz, float x, float y, float z, float w,
+                   float sx, float sy, float sz) {
+      const float xx = x * x, yy = y * y, zz = z * z;
+      const float xy = x * y, xz = x * z, yz = y * z;
+      const float wx = w * x, wy = w * y, wz = w * z;
+
+      m[0] = (1 - 2 * (yy + zz)) * sx;
+      m[1] = 2 * (xy + wz) * sx;
+      m[2] = 2 * (xz - wy) * sx;
+      m[3] = 0;
+      m[4] = 2 * (xy - wz) * sy;
+      m[5] = (1 - 2 * (xx + zz)) * sy;
+      m[6] = 2 * (yz + wx) * sy;
+      m[7] = 0;
+      m[8] = 2 * (xz + wy) * sz;
+      m[9] = 2 * (yz - wx) * sz;
+      m[10] = (1 - 2 * (xx + yy)) * sz;
+      m[11] = 0;
+      m[12] = px;
+      m[13] = py;
+      m[14] = pz;
+      m[15] = 1;
+   }
+
+   template <typename Dest>
+   void composeScalar(const TrsArrays& trs, size_t begin, size_t end, const Dest& dst) {
+      for (auto i = begin; i < end; ++i) {
+         composeOne(dst(i), trs.px[i], trs.py[i], trs.pz[i], trs.rx[i], trs.ry[i], trs.rz[i],
+                    trs.rw[i], trs.sx[i], trs.sy[i], trs.sz[i]);
+      }
+   }
+
+#ifdef GS_TRANSFORM_SSE
+   /// Takes the 12 non-constant matrix entries of 4 transforms, one transform per lane,
+   /// and transposes them into 4 matrices
+   template <typename Dest>
+   void store4(size_t i, __m128 (&v)[12], const Dest& dst) {
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 one = _mm_set1_ps(1.0f);
+      __m128 columns[4][4] = {
+         {v[0], v[1], v[2], zero},
+         {v[3], v[4], v[5], zero},
+         {v[6], v[7], v[8], zero},
+         {v[9], v[10], v[11], one},
+      };
+      for (size_t c = 0; c < 4; ++c) {
+         _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+         for (size_t k = 0; k < 4; ++k) _mm_storeu_ps(dst(i + k) + 4 * c, columns[c][k]);
+      }
+   }
+
+   template <typename Dest>
+   void composeSse(const TrsArrays& trs, size_t begin, size_t end, const Dest& dst) {
+      const __m128 one = _mm_set1_ps(1.0f);
+      const __m128 two = _mm_set1_ps(2.0f);
+      for (auto i = begin; i < end; i += 4) {
+         const __m128 x = _mm_loadu_ps(&trs.rx[i]), y = _mm_loadu_ps(&trs.ry[i]);
+         const __m128 z = _mm_loadu_ps(&trs.rz[i]), w = _mm_loadu_ps(&trs.rw[i]);
+         const __m128 sx = _mm_loadu_ps(&trs.sx[i]), sy = _mm_loadu_ps(&trs.sy[i]);
+         const __m128 sz = _mm_loadu_ps(&trs.sz[i]);
+
+         const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+         const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+         const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+         auto diagonal = [&](__m128 a, __m128 b, __m128 s) {
+            return _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(a, b))), s);
+         };
+         auto sum = [&](__m128 a, __m128 b, __m128 s) {
+            return _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(a, b)), s);
+         };
+         auto difference = [&](__m128 a, __m128 b, __m128 s) {
+            return _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(a, b)), s);
+         };
+
+         __m128 v[12] = {
+            diagonal(yy, zz, sx), sum(xy, wz, sx), difference(xz, wy, sx),
+            difference(xy, wz, sy), diagonal(xx, zz, sy), sum(yz, wx, sy),
+            sum(xz, wy, sz), difference(yz, wx, sz), diagonal(xx, yy, sz),
+            _mm_loadu_ps(&trs.px[i]), _mm_loadu_ps(&trs.py[i]), _mm_loadu_ps(&trs.pz[i]),
+         };
+         store4(i, v, dst);
+      }
+   }
+#endif
+
+#ifdef GS_TRANSFORM_AVX2
+   template <typename Dest>
+   void composeAvx2(const TrsArrays& trs, size_t begin, size_t end, const Dest& dst) {
+      const __m256 one = _mm256_set1_ps(1.0f);
+      const __m256 two = _mm256_set1_ps(2.0f);
+      for (auto i = begin; i < end; i += 8) {
+         const __m256 x = _mm256_loadu_ps(&trs.rx[i]), y = _mm256_loadu_ps(&trs.ry[i]);
+         const __m256 z = _mm256_loadu_ps(&trs.rz[i]), w = _mm256_loadu_ps(&trs.rw[i]);
+         const __m256 sx = _mm256_loadu_ps(&trs.sx[i]), sy = _mm256_loadu_ps(&trs.sy[i]);
+         const __m256 sz = _mm256_loadu_ps(&trs.sz[i]);
+
+         const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+         const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+         const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+         auto diagonal = [&](__m256 a, __m256 b, __m256 s) {
+            return _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(a, b))), s);
+         };
+         auto sum = [&](__m256 a, __m256 b, __m256 s) {
+            return _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(a, b)), s);
+         };
+         auto difference = [&](__m256 a, __m256 b, __m256 s) {
+            return _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(a, b)), s);
+         };
+
+         const __m256 v[12] = {
+            diagonal(yy, zz, sx), sum(xy, wz, sx), difference(xz, wy, sx),
+            difference(xy, wz, sy), diagonal(xx, zz, sy), sum(yz, wx, sy),
+            sum(xz, wy, sz), difference(yz, wx, sz), diagonal(xx, yy, sz),
+            _mm256_loadu_ps(&trs.px[i]), _mm256_loadu_ps(&trs.py[i]), _mm256_loadu_ps(&trs.pz[i]),
+         };
+
+         // the transpose works on 4 lanes, so each half is stored on its own
+         __m128 low[12], high[12];
+         for (size_t k = 0; k < 12; ++k) {
+            low[k] = _mm256_castps256_ps128(v[k]);
+            high[k] = _mm256_extractf128_ps(v[k], 1);
+         }
+         store4(i, low, dst);
+         store4(i + 4, high, dst);
+      }
+   }
+#endif
+
+   /// Quaternion of a pure rotation matrix given as r[row][column], same as QQuaternion::fromRotationMatrix
+   void toQuaternion(const float (&r)[3][3], float& x, float& y, float& z, float& w) {
+      float axis[3];
+      const float trace = r[0][0] + r[1][1] + r[2][2];
+      if (trace > 0.00000001f) {
+         const float s = 2.0f * std::sqrt(trace + 1.0f);
+         w = 0.25f * s;
+         axis[0] = (r[2][1] - r[1][2]) / s;
+         axis[1] = (r[0][2] - r[2][0]) / s;
+         axis[2] = (r[1][0] - r[0][1]) / s;
+      } else {
+         constexpr int next[3] = {1, 2, 0};
+         int i = 0;
+         if (r[1][1] > r[0][0]) i = 1;
+         if (r[2][2] > r[i][i]) i = 2;
+         const int j = next[i];
+         const int k = next[j];
+         const float s = 2.0f * std::sqrt(r[i][i] - r[j][j] - r[k][k] + 1.0f);
+         axis[i] = 0.25f * s;
+         w = (r[k][j] - r[j][k]) / s;
+         axis[j] = (r[j][i] + r[i][j]) / s;
+         axis[k] = (r[k][i] + r[i][k]) / s;
+      }
+      x = axis[0];
+      y = axis[1];
+      z = axis[2];
+   }
+
+   void decomposeScalar(const QMatrix4x4* matrices, size_t begin, size_t end, TrsArrays& out) {
+      for (auto i = begin; i < end; ++i) {
+         const float* m = matrices[i].constData();
+         float* scales[3] = {&out.sx[i], &out.sy[i], &out.sz[i]};
+         float r[3][3];
+         for (int c = 0; c < 3; ++c) {
+            const float* column = m + 4 * c;
+            *scales[c] = std::sqrt(column[0] * column[0] + column[1] * column[1] +
+                                   column[2] * column[2]);
+            for (int row = 0; row < 3; ++row) r[row][c] = column[row] / *scales[c];
+         }
+         toQuaternion(r, out.rx[i], out.ry[i], out.rz[i], out.rw[i]);
+         out.px[i] = m[12];
+         out.py[i] = m[13];
+         out.pz[i] = m[14];
+      }
+   }
+
+#ifdef GS_TRANSFORM_SSE
+   /// Scale and position of 4 matrices are extracted lane-wise, only the quaternion
+   /// conversion has to branch and runs per matrix
+   void decomposeSse(const QMatrix4x4* matrices, size_t begin, size_t end, TrsArrays& out) {
+      for (auto i = begin; i < end; i += 4) {
+         const float* m[4] = {matrices[i].constData(), matrices[i + 1].constData(),
+                              matrices[i + 2].constData(), matrices[i + 3].constData()};
+         float* scales[3] = {&out.sx[i], &out.sy[i], &out.sz[i]};
+         alignas(16) float r[3][3][4];
+
+         for (int c = 0; c < 3; ++c) {
+            __m128 x = _mm_loadu_ps(m[0] + 4 * c), y = _mm_loadu_ps(m[1] + 4 * c);
+            __m128 z = _mm_loadu_ps(m[2] + 4 * c), w = _mm_loadu_ps(m[3] + 4 * c);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+
+            const __m128 length = _mm_sqrt_ps(
+                  _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+            _mm_storeu_ps(scales[c], length);
+            _mm_store_ps(r[0][c], _mm_div_ps(x, length));
+            _mm_store_ps(r[1][c], _mm_div_ps(y, length));
+            _mm_store_ps(r[2][c], _mm_div_ps(z, length));
+         }
+
+         __m128 px = _mm_loadu_ps(m[0] + 12), py = _mm_loadu_ps(m[1] + 12);
+         __m128 pz = _mm_loadu_ps(m[2] + 12), pw = _mm_loadu_ps(m[3] + 12);
+         _MM_TRANSPOSE4_PS(px, py, pz, pw);
+         _mm_storeu_ps(&out.px[i], px);
+         _mm_storeu_ps(&out.py[i], py);
+         _mm_storeu_ps(&out.pz[i], pz);
+
+         for (size_t lane = 0; lane < 4; ++lane) {
+            const float rotation[3][3] = {
+               {r[0][0][lane], r[0][1][lane], r[0][2][lane]},
+               {r[1][0][lane], r[1][1][lane], r[1][2][lane]},
+               {r[2][0][lane], r[2][1][lane], r[2][2][lane]},
+            };
+            const auto index = i + lane;
+            toQuaternion(rotation, out.rx[index], out.ry[index], out.rz[index], out.rw[index]);
+         }
+      }
+   }
+#endif
+
+   template <typename Dest>
+   void compose(const TrsArrays& trs, const Dest& dst) {
+      const auto count = trs.size();
+      size_t done = 0;
+#ifdef GS_TRANSFORM_AVX2
+      composeAvx2(trs, done, count - count % 8, dst);
+      done = count - count % 8;
+#endif
+#ifdef GS_TRANSFORM_SSE
+      composeSse(trs, done, count - count % 4, dst);
+      done = std::max(done, count - count % 4);
+#endif
+      composeScalar(trs, done, count, dst);
+   }
+}
+
+namespace TransformMath {
+
+   void TrsArrays::resize(size_t count) {
+      for (auto* array: {&px, &py, &pz, &rx, &ry, &rz, &rw, &sx, &sy, &sz}) array->resize(count);
+   }
+
+   void TrsArrays::set(size_t index, const QVector3D& position, const QQuaternion& rotation,
+                       const QVector3D& scale) {
+      px[index] = position.x();
+      py[index] = position.y();
+      pz[index] = position.z();
+      rx[index] = rotation.x();
+      ry[index] = rotation.y();
+      rz[index] = rotation.z();
+      rw[index] = rotation.scalar();
+      sx[index] = scale.x();
+      sy[index] = scale.y();
+      sz[index] = scale.z();
+   }
+
+   QMatrix4x4 composeTRS(const QVector3D& position, const QQuaternion& rotation,
+                         const QVector3D& scale) {
+      QMatrix4x4 matrix;
+      composeOne(matrix.data(), position.x(), position.y(), position.z(), rotation.x(),
+                 rotation.y(), rotation.z(), rotation.scalar(), scale.x(), scale.y(), scale.z());
+      return matrix;
+   }
+
+   void composeTRS(const TrsArrays& trs, QMatrix4x4* out) {
+      // data() also resets the matrix type, Qt would treat it as identity otherwise
+      compose(trs, [out](size_t i) { return out[i].data(); });
+   }
+
+   void composeTRS(const TrsArrays& trs, float* out) {
+      compose(trs, [out](size_t i) { return out + 16 * i; });
+   }
+
+   QMatrix4x4 inverseAffine(const QMatrix4x4& matrix) {
+      const float* m = matrix.constData();
+      // a = upper 3x3 in row-major, its inverse is the transposed cofactor matrix over the determinant
+      const float a00 = m[0], a01 = m[4], a02 = m[8];
+      const float a10 = m[1], a11 = m[5], a12 = m[9];
+      const float a20 = m[2], a21 = m[6], a22 = m[10];
+
+      const float c00 = a11 * a22 - a12 * a21;
+      const float c01 = a12 * a20 - a10 * a22;
+      const float c02 = a10 * a21 - a11 * a20;
+      const float inverseDeterminant = 1.0f / (a00 * c00 + a01 * c01 + a02 * c02);
+
+      float b[3][3] = {
+         {c00, a02 * a21 - a01 * a22, a01 * a12 - a02 * a11},
+         {c01, a00 * a22 - a02 * a20, a02 * a10 - a00 * a12},
+         {c02, a01 * a20 - a00 * a21, a00 * a11 - a01 * a10},
+      };
+      for (auto& row: b) {
+         for (auto& value: row) value *= inverseDeterminant;
+      }
+
+      QMatrix4x4 inverse;
+      float* r = inverse.data();
+      for (int row = 0; row < 3; ++row) {
+         for (int column = 0; column < 3; ++column) r[4 * column + row] = b[row][column];
+         r[12 + row] = -(b[row][0] * m[12] + b[row][1] * m[13] + b[row][2] * m[14]);
+         r[4 * row + 3] = 0;
+      }
+      r[15] = 1;
+      return inverse;
+   }
+
+   QMatrix4x4 inverseRigid(const QMatrix4x4& matrix) {
+      const float* m = matrix.constData();
+      QMatrix4x4 inverse;
+      float* r = inverse.data();
+      // the rotation is orthonormal, so its inverse is its transpose
+      for (int row = 0; row < 3; ++row) {
+         for (int column = 0; column < 3; ++column) r[4 * column + row] = m[4 * row + column];
+         r[12 + row] = -(m[4 * row] * m[12] + m[4 * row + 1] * m[13] + m[4 * row + 2] * m[14]);
+         r[4 * row + 3] = 0;
+      }
+      r[15] = 1;
+      return inverse;
+   }
+
+   Trs decompose(const QMatrix4x4& matrix) {
+      TrsArrays trs;
+      decompose(&matrix, 1, trs);
+      return {
+         QVector3D(trs.px[0], trs.py[0], trs.pz[0]),
+         QQuaternion(trs.rw[0], trs.rx[0], trs.ry[0], trs.rz[0]),
+         QVector3D(trs.sx[0], trs.sy[0], trs.sz[0]),
+      };
+   }
+
+   void decompose(const QMatrix4x4* matrices, size_t count, TrsArrays& out) {
+      out.resize(count);
+      size_t done = 0;
+#ifdef GS_TRANSFORM_SSE
+      decomposeSse(matrices, 0, count - count % 4, out);
+      done = count - count % 4;
+#endif
+      decomposeScalar(matrices, done, count, out);
+   }
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QVector3D>
+#include <cstddef>
+#include <vector>
+
+namespace TransformMath {
+
+   /// Position, rotation and scale of many transforms as structure of arrays, so the batch
+   /// kernels can load 4 (SSE) or 8 (AVX2) transforms per instruction
+   struct TrsArrays {
+      std::vector<float> px, py, pz;
+      std::vector<float> rx, ry, rz, rw;
+      std::vector<float> sx, sy, sz;
+
+      size_t size() const { return px.size(); }
+      void resize(size_t count);
+      void set(size_t index, const QVector3D& position, const QQuaternion& rotation,
+               const QVector3D& scale);
+   };
+
+   /// Same as translating, rotating and scaling an identity matrix, the rotation has to be normalized
+   QMatrix4x4 composeTRS(const QVector3D& position, const QQuaternion& rotation,
+                         const QVector3D& scale);
+
+   /// Composes trs.size() matrices, out must have room for all of them
+   void composeTRS(const TrsArrays& trs, QMatrix4x4* out);
+
+   /// Same as above but writes 16 column-major floats per transform
+   void composeTRS(const TrsArrays& trs, float* out);
+
+   /// Inverse of a translation * rotation * scale matrix, much cheaper than a general 4x4 inverse
+   QMatrix4x4 inverseAffine(const QMatrix4x4& matrix);
+
+   /// Inverse of a translation * rotation matrix without any scale
+   QMatrix4x4 inverseRigid(const QMatrix4x4& matrix);
+
+   struct Trs {
+      QVector3D position;
+      QQuaternion rotation;
+      QVector3D scale;
+   };
+
+   /// Splits a translation * rotation * scale matrix into its parts
+   Trs decompose(const QMatrix4x4& matrix);
+
+   /// Decomposes count matrices at once, out is resized to count
+   void decompose(const QMatrix4x4* matrices, size_t count, TrsArrays& out);
+
+}
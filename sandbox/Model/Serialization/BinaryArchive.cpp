@@ -0,0 +1,310 @@
+#include "BinaryArchive.h"
+#include "Common/JobSystem.h"
+#include "Common/Lz4.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "blobs are stored in native byte order");
+
+namespace {
+   constexpr auto StreamVersion = QDataStream::Qt_6_5;
+
+   void setupStream(QDataStream& stream) {
+      stream.setByteOrder(QDataStream::LittleEndian);
+      stream.setVersion(StreamVersion);
+   }
+
+   /// Groups the n-th bytes of all scalars, bytes after the last whole scalar stay in place
+   void shuffle(const uchar* source, uchar* destination, size_t size, uint32_t scalarSize) {
+      const auto count = size / scalarSize;
+      for (size_t i = 0; i < count; ++i) {
+         for (uint32_t byte = 0; byte < scalarSize; ++byte) {
+            destination[byte * count + i] = source[i * scalarSize + byte];
+         }
+      }
+      std::memcpy(destination + count * scalarSize, source + count * scalarSize,
+                  size - count * scalarSize);
+   }
+
+   void unshuffle(const uchar* source, uchar* destination, size_t size, uint32_t scalarSize) {
+      const auto count = size / scalarSize;
+      for (size_t i = 0; i < count; ++i) {
+         for (uint32_t byte = 0; byte < scalarSize; ++byte) {
+            destination[i * scalarSize + byte] = source[byte * count + i];
+         }
+      }
+      std::memcpy(destination + count * scalarSize, source + count * scalarSize,
+                  size - count * scalarSize);
+   }
+
+   /// The block as it is stored, the data itself if compressing doesn't make it smaller
+   QByteArray compressBlock(const uchar* data, size_t size, uint32_t scalarSize) {
+      std::vector<uchar> shuffled;
+      if (scalarSize > 1) {
+         shuffled.resize(size);
+         shuffle(data, shuffled.data(), size, scalarSize);
+      }
+      QByteArray block(qsizetype(size - 1), Qt::Uninitialized);
+      const auto compressed = Lz4::compress(shuffled.empty() ? data : shuffled.data(), size,
+                                            block.data(), size - 1);
+      if (compressed == 0) {
+         return QByteArray::fromRawData(reinterpret_cast<const char*>(data), qsizetype(size));
+      }
+      block.resize(qsizetype(compressed));
+      return block;
+   }
+
+   size_t indexSize(const BinaryArchive::CompressedBlob& header) {
+      return sizeof(header) + header.blockCount * sizeof(uint64_t);
+   }
+
+   bool readHeader(const uchar* blob, uint64_t size, BinaryArchive::CompressedBlob& header) {
+      if (size < sizeof(header)) return false;
+      std::memcpy(&header, blob, sizeof(header));
+      if (header.magic != BinaryArchive::CompressedBlob().magic || header.blockSize == 0 ||
+          header.blockSize > BinaryArchive::BlockSize || header.scalarSize == 0 ||
+          header.scalarSize > 64 || indexSize(header) > size) {
+         return false;
+      }
+      // loaders allocate the decompressed size up front, so a corrupt one must not claim more
+      // than the blocks hold or than the stored bytes can decompress to
+      const auto stored = size - indexSize(header);
+      return header.size <= uint64_t(header.blockCount) * header.blockSize &&
+             header.size <= stored * Lz4::MaxRatio &&
+             header.blockCount == (header.size + header.blockSize - 1) / header.blockSize;
+   }
+
+   bool decompressBlocks(const uchar* blob, uint64_t size, uchar* destination) {
+      BinaryArchive::CompressedBlob header;
+      if (!readHeader(blob, size, header)) return false;
+      std::vector<uint64_t> ends(header.blockCount);
+      std::memcpy(ends.data(), blob + sizeof(header), ends.size() * sizeof(uint64_t));
+
+      std::atomic<bool> ok = true;
+      JobSystem::instance().parallelFor(ends.size(), 1, [&](size_t begin, size_t end) {
+         std::vector<uchar> shuffled;
+         for (size_t i = begin; i < end; ++i) {
+            const auto start = i == 0 ? indexSize(header) : ends[i - 1];
+            const auto offset = i * header.blockSize;
+            const auto blockSize = std::min<uint64_t>(header.blockSize, header.size - offset);
+            if (ends[i] < start || ends[i] > size) {
+               ok = false;
+               continue;
+            }
+
+            const auto* block = blob + start;
+            const auto stored = ends[i] - start;
+            auto* target = destination + offset;
+            if (stored == blockSize) {
+               std::memcpy(target, block, blockSize);
+            } else if (header.scalarSize == 1) {
+               if (!Lz4::decompress(block, stored, target, blockSize)) ok = false;
+            } else {
+               shuffled.resize(blockSize);
+               if (Lz4::decompress(block, stored, shuffled.data(), blockSize)) {
+                  unshuffle(shuffled.data(), target, blockSize, header.scalarSize);
+               } else {
+                  ok = false;
+               }
+            }
+         }
+      });
+      return ok;
+   }
+}
+
+BinaryWriter::BinaryWriter(QIODevice& device, BinaryArchive::Compression compression)
+   : m_device(device), m_compression(compression) {
+   setupStream(m_record);
+   // the header is patched once the table has been written
+   BinaryArchive::Header header;
+   m_failed = m_device.write(reinterpret_cast<const char*>(&header), sizeof(header)) !=
+              sizeof(header);
+}
+
+BlobRef BinaryWriter::blob(const void* data, uint64_t size, uint32_t scalarSize) {
+   if (size == 0) return {};
+   pad();
+   if (m_compression == BinaryArchive::Compression::Lz4 &&
+       size >= BinaryArchive::CompressThreshold) {
+      return compressedBlob(static_cast<const uchar*>(data), size,
+                            std::max<uint32_t>(scalarSize, 1));
+   }
+   BlobRef ref{static_cast<uint64_t>(m_device.pos()), size};
+   m_failed |= m_device.write(static_cast<const char*>(data), size) != qint64(size);
+   return ref;
+}
+
+BlobRef BinaryWriter::compressedBlob(const uchar* data, uint64_t size, uint32_t scalarSize) {
+   BinaryArchive::CompressedBlob header;
+   header.size = size;
+   header.blockCount = uint32_t((size + header.blockSize - 1) / header.blockSize);
+   header.scalarSize = scalarSize;
+   const auto start = m_device.pos();
+   m_failed |= m_device.write(reinterpret_cast<const char*>(&header), sizeof(header)) !=
+               sizeof(header);
+   // the ends of the blocks are patched in once they are known
+   std::vector<uint64_t> ends(header.blockCount);
+   const auto endsSize = qint64(ends.size() * sizeof(uint64_t));
+   m_failed |= m_device.write(reinterpret_cast<const char*>(ends.data()), endsSize) != endsSize;
+
+   // a window of blocks is compressed in parallel, then written in order
+   auto& jobs = JobSystem::instance();
+   const auto window = std::max<size_t>(jobs.workerCount(), 1) * 4;
+   std::vector<QByteArray> blocks;
+   uint64_t end = indexSize(header);
+   for (size_t first = 0; first < ends.size(); first += window) {
+      const auto count = std::min(window, ends.size() - first);
+      blocks.assign(count, {});
+      jobs.parallelFor(count, 1, [&](size_t begin, size_t last) {
+         for (size_t i = begin; i < last; ++i) {
+            const auto offset = (first + i) * header.blockSize;
+            const auto blockSize = std::min<uint64_t>(header.blockSize, size - offset);
+            blocks[i] = compressBlock(data + offset, blockSize, scalarSize);
+         }
+      });
+      for (size_t i = 0; i < count; ++i) {
+         m_failed |= m_device.write(blocks[i]) != blocks[i].size();
+         end += blocks[i].size();
+         ends[first + i] = end;
+      }
+   }
+
+   m_failed |= !m_device.seek(start + qint64(sizeof(header)));
+   m_failed |= m_device.write(reinterpret_cast<const char*>(ends.data()), endsSize) != endsSize;
+   m_failed |= !m_device.seek(start + qint64(end));
+   return {static_cast<uint64_t>(start), end, true};
+}
+
+void BinaryWriter::beginSection(SectionTag tag) {
+   m_buffer.close();
+   m_sections.push_back({tag, {}});
+   m_buffer.setBuffer(&m_sections.back().data);
+   m_buffer.open(QIODevice::WriteOnly);
+   m_record.setDevice(&m_buffer);
+}
+
+void BinaryWriter::patch(qint64 position, quint64 value) {
+   const auto end = m_buffer.pos();
+   m_buffer.seek(position);
+   m_record << value;
+   m_buffer.seek(end);
+}
+
+bool BinaryWriter::finish() {
+   m_buffer.close();
+   m_record.setDevice(nullptr);
+
+   std::vector<BinaryArchive::Section> table;
+   for (const auto& section: m_sections) {
+      pad();
+      table.push_back({.tag = section.tag,
+                       .offset = static_cast<uint64_t>(m_device.pos()),
+                       .size = static_cast<uint64_t>(section.data.size())});
+      m_failed |= m_device.write(section.data) != section.data.size();
+   }
+   m_sections.clear();
+
+   pad();
+   BinaryArchive::Header header;
+   header.sectionCount = static_cast<uint32_t>(table.size());
+   header.tableOffset = m_device.pos();
+   const auto tableSize = qint64(table.size() * sizeof(BinaryArchive::Section));
+   m_failed |= m_device.write(reinterpret_cast<const char*>(table.data()), tableSize) != tableSize;
+
+   m_failed |= !m_device.seek(0);
+   m_failed |= m_device.write(reinterpret_cast<const char*>(&header), sizeof(header)) !=
+               sizeof(header);
+   return !m_failed;
+}
+
+void BinaryWriter::pad() {
+   static constexpr std::array<char, BinaryArchive::Alignment> zeros = {};
+   const auto misalignment = m_device.pos() % BinaryArchive::Alignment;
+   if (misalignment == 0) return;
+   const auto padding = qint64(BinaryArchive::Alignment - misalignment);
+   m_failed |= m_device.write(zeros.data(), padding) != padding;
+}
+
+bool BinaryReader::open(const QString& path) {
+   m_file = std::make_shared<MappedFile>();
+   m_sections.clear();
+   m_file->file.setFileName(path);
+   if (!m_file->file.open(QIODevice::ReadOnly)) {
+      GS_DEBUG() << "Couldn't open" << path;
+      return false;
+   }
+
+   m_file->size = m_file->file.size();
+   m_file->data = m_file->file.map(0, m_file->size);
+   if (!m_file->data) {
+      // e.g. files on devices which don't support mapping
+      m_file->copy = m_file->file.readAll();
+      m_file->data = reinterpret_cast<uchar*>(m_file->copy.data());
+   }
+
+   BinaryArchive::Header header;
+   if (m_file->size < qint64(sizeof(header))) return false;
+   std::memcpy(&header, m_file->data, sizeof(header));
+   if (header.magic != BinaryArchive::Magic || header.version > BinaryArchive::Version) {
+      GS_DEBUG() << path << "is no binary scene or was written by a newer version";
+      return false;
+   }
+
+   const BlobRef table{header.tableOffset, header.sectionCount * sizeof(BinaryArchive::Section)};
+   const auto* tableData = blob(table);
+   if (header.sectionCount != 0 && !tableData) return false;
+   m_sections.resize(header.sectionCount);
+   if (tableData) std::memcpy(m_sections.data(), tableData, table.size);
+
+   setupStream(m_record);
+   m_record.setDevice(&m_buffer);
+   return true;
+}
+
+bool BinaryReader::beginSection(SectionTag tag) {
+   auto section = std::ranges::find(m_sections, tag, &BinaryArchive::Section::tag);
+   if (section == m_sections.end()) return false;
+   const auto* data = mapped({section->offset, section->size});
+   if (!data && section->size != 0) return false;
+
+   m_buffer.close();
+   m_section = QByteArray::fromRawData(reinterpret_cast<const char*>(data), section->size);
+   m_buffer.setBuffer(&m_section);
+   m_buffer.open(QIODevice::ReadOnly);
+   m_record.resetStatus();
+   return true;
+}
+
+const uchar* BinaryReader::blob(const BlobRef& blob) const {
+   return blob.compressed ? nullptr : mapped(blob);
+}
+
+uint64_t BinaryReader::size(const BlobRef& blob) const {
+   if (!blob.compressed) return blob.size;
+   BinaryArchive::CompressedBlob header;
+   const auto* data = mapped(blob);
+   return data && readHeader(data, blob.size, header) ? header.size : 0;
+}
+
+BinaryReader::Unpacker BinaryReader::unpacker(const BlobRef& blob) const {
+   return [file = m_file, blob](void* destination) {
+      const auto* data = mapped(file.get(), blob);
+      if (!data) return false;
+      if (!blob.compressed) {
+         std::memcpy(destination, data, blob.size);
+         return true;
+      }
+      return decompressBlocks(data, blob.size, static_cast<uchar*>(destination));
+   };
+}
+
+const uchar* BinaryReader::mapped(const BlobRef& blob) const { return mapped(m_file.get(), blob); }
+
+const uchar* BinaryReader::mapped(const MappedFile* file, const BlobRef& blob) {
+   if (!file || blob.size == 0) return nullptr;
+   const auto size = static_cast<uint64_t>(file->size);
+   if (blob.offset > size || blob.size > size - blob.offset) return nullptr;
+   return file->data + blob.offset;
+}
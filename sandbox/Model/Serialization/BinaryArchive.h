@@ -0,0 +1,192 @@
+#pragma once
+#include "Common/Common.h"
+#include "Model/Components/MeshStream.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+#include <array>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/// Location of a payload inside a binary archive, offsets are absolute file offsets. The size is
+/// the one in the file, compressed blobs know their decompressed size from their block index.
+struct BlobRef {
+   uint64_t offset = 0;
+   uint64_t size = 0;
+   bool compressed = false;
+};
+
+// blobs are aligned, so the lowest bit of the offset marks the compressed ones
+inline QDataStream& operator<<(QDataStream& stream, const BlobRef& blob) {
+   return stream << quint64(blob.offset | (blob.compressed ? 1 : 0)) << quint64(blob.size);
+}
+
+inline QDataStream& operator>>(QDataStream& stream, BlobRef& blob) {
+   quint64 offset, size;
+   stream >> offset >> size;
+   blob = {offset & ~quint64(1), size, (offset & 1) != 0};
+   return stream;
+}
+
+using SectionTag = std::array<char, 4>;
+
+/// Layout of binary archives (little endian):
+///  - header: magic, version, offset and size of the section table
+///  - raw blobs, every one aligned to BinaryAlignment so it can be used in place after mapping
+///  - sections of small records written with QDataStream, each aligned as well
+///  - the section table, one entry per section with its tag, offset and size
+/// Compressed blobs start with a CompressedBlob header and the end of every block, followed by
+/// the blocks. Each block is compressed with Lz4 on its own, so any part of a blob can be read
+/// without the rest, blocks which don't get smaller are stored as they are.
+struct BinaryArchive {
+   static constexpr std::array<char, 8> Magic = {'G', 'S', 'S', 'C', 'E', 'N', 'E', 'B'};
+   // 2: blobs may be compressed
+   static constexpr uint32_t Version = 2;
+   static constexpr uint64_t Alignment = 64;
+
+   enum class Compression { None, Lz4 };
+   /// Smaller blobs aren't worth a block index
+   static constexpr uint64_t CompressThreshold = 4096;
+   static constexpr uint32_t BlockSize = 64 * 1024;
+
+   struct Header {
+      std::array<char, 8> magic = Magic;
+      uint32_t version = Version;
+      uint32_t sectionCount = 0;
+      uint64_t tableOffset = 0;
+      std::array<char, 40> reserved = {};
+   };
+
+   struct Section {
+      SectionTag tag = {};
+      uint32_t reserved = 0;
+      uint64_t offset = 0;
+      uint64_t size = 0;
+      uint64_t reserved2 = 0;
+   };
+
+   struct CompressedBlob {
+      std::array<char, 4> magic = {'L', 'Z', '4', 'B'};
+      uint32_t blockSize = BlockSize;
+      uint64_t size = 0;// decompressed
+      uint32_t blockCount = 0;
+      // the bytes of each scalar are grouped before compressing, which suits floats and pixels
+      uint32_t scalarSize = 1;
+      uint64_t reserved = 0;
+   };
+
+   static_assert(sizeof(Header) == 64 && sizeof(Section) == 32 && sizeof(CompressedBlob) == 32);
+};
+
+/// Streams blobs straight to the device while the small records are collected per section,
+/// the sections and the table are written by finish()
+class BinaryWriter {
+public:
+   explicit BinaryWriter(QIODevice& device,
+                         BinaryArchive::Compression compression = BinaryArchive::Compression::None);
+
+   /// Appends raw data to the file, aligned so it can be viewed in place after mapping. With
+   /// compression the blocks of large blobs are compressed in parallel instead, scalarSize is
+   /// the size of the numbers the data consists of.
+   BlobRef blob(const void* data, uint64_t size, uint32_t scalarSize = 1);
+
+   // the elements of streams are vectors of scalars or scalars themselves
+   template<typename T>
+   BlobRef blob(const MeshStream<T>& stream) {
+      return blob(stream.data(), stream.size() * sizeof(T), alignof(T));
+   }
+
+   /// Records go into this section until the next one begins
+   void beginSection(SectionTag tag);
+   QDataStream& record() { return m_record; }
+
+   /// Position inside the current section, used to patch sizes written up front
+   qint64 position() const { return m_buffer.pos(); }
+   void patch(qint64 position, quint64 value);
+
+   bool finish();
+
+private:
+   void pad();
+   BlobRef compressedBlob(const uchar* data, uint64_t size, uint32_t scalarSize);
+
+private:
+   struct Section {
+      SectionTag tag;
+      QByteArray data;
+   };
+
+   QIODevice& m_device;
+   BinaryArchive::Compression m_compression;
+   std::deque<Section> m_sections;// records are streamed into the last one
+   QBuffer m_buffer;
+   QDataStream m_record;
+   bool m_failed = false;
+};
+
+/// Maps an archive and gives out views into it. Falls back to reading the file into memory if it
+/// can't be mapped, the views keep whichever it is alive.
+class BinaryReader {
+public:
+   bool open(const QString& path);
+
+   /// Moves the record stream to the start of the section, false if the archive has none
+   bool beginSection(SectionTag tag);
+   QDataStream& record() { return m_record; }
+
+   /// Start of the blob or nullptr if it lies outside the file or is compressed
+   const uchar* blob(const BlobRef& blob) const;
+
+   /// Decompressed size of the blob, read from its block index
+   uint64_t size(const BlobRef& blob) const;
+
+   /// Copies size(blob) bytes of the blob to its argument and returns whether they were valid,
+   /// compressed blocks are decompressed in parallel. Keeps the file alive and can be called on
+   /// any thread, also after the reader is gone.
+   using Unpacker = std::function<bool(void* destination)>;
+   Unpacker unpacker(const BlobRef& blob) const;
+
+   /// Uncompressed streams view the mapping, compressed ones are decompressed on first access
+   template<typename T>
+   MeshStream<T> stream(const BlobRef& ref) const {
+      if (ref.compressed) {
+         const auto size = this->size(ref);
+         if (size == 0 || size % sizeof(T) != 0) return {};
+         return MeshStream<T>::Deferred(size / sizeof(T), [unpack = unpacker(ref), size] {
+            std::vector<T> elements(size / sizeof(T));
+            if (!unpack(elements.data())) return MeshStream<T>();
+            return MeshStream<T>(std::move(elements));
+         });
+      }
+      const auto* data = blob(ref);
+      if (!data || ref.size % sizeof(T) != 0) return {};
+      return MeshStream<T>::View(reinterpret_cast<const T*>(data), ref.size / sizeof(T), owner());
+   }
+
+   /// Keeps the mapping alive, every view handed out holds one
+   sptr<const void> owner() const { return m_file; }
+
+private:
+   struct MappedFile {
+      QFile file;
+      uchar* data = nullptr;
+      qint64 size = 0;
+      QByteArray copy;
+
+      ~MappedFile() {
+         if (data && copy.isEmpty()) file.unmap(data);
+      }
+   };
+
+   /// Start of the blob in the file whether it's compressed or not, nullptr if it lies outside
+   const uchar* mapped(const BlobRef& blob) const;
+   static const uchar* mapped(const MappedFile* file, const BlobRef& blob);
+
+private:
+   sptr<MappedFile> m_file;
+   std::vector<BinaryArchive::Section> m_sections;
+   QByteArray m_section;
+   QBuffer m_buffer;
+   QDataStream m_record;
+};
@@ -0,0 +1,248 @@
+#include "JsonStream.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <cmath>
+#include <utility>
+
+namespace {
+   constexpr qint64 ChunkSize = 1 << 16;
+   constexpr qsizetype CompactThreshold = 1 << 20;
+
+   QByteArray quoted(const QString& string) {
+      const auto utf8 = string.toUtf8();
+      QByteArray result;
+      result.reserve(utf8.size() + 2);
+      result += '"';
+      for (char c: utf8) {
+         switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+               if (static_cast<unsigned char>(c) < 0x20) {
+                  result += "\\u00" + QByteArray::number(c, 16).rightJustified(2, '0');
+               } else {
+                  result += c;
+               }
+         }
+      }
+      result += '"';
+      return result;
+   }
+
+   bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+}
+
+JsonStreamWriter::JsonStreamWriter(QIODevice& device) : m_device(device) {}
+
+void JsonStreamWriter::beginObject() {
+   separate();
+   write("{");
+   m_first.push_back(true);
+}
+
+void JsonStreamWriter::endObject() {
+   m_first.pop_back();
+   write("}");
+}
+
+void JsonStreamWriter::beginArray() {
+   separate();
+   write("[");
+   m_first.push_back(true);
+}
+
+void JsonStreamWriter::endArray() {
+   m_first.pop_back();
+   write("]");
+}
+
+void JsonStreamWriter::key(const QString& key) {
+   separate();
+   write(quoted(key) + ':');
+   m_afterKey = true;
+}
+
+void JsonStreamWriter::value(const QJsonValue& value) { encodedValue(encode(value)); }
+
+void JsonStreamWriter::encodedValue(const QByteArray& json) {
+   separate();
+   write(json);
+}
+
+QByteArray JsonStreamWriter::encode(const QJsonValue& value) {
+   switch (value.type()) {
+      case QJsonValue::Object: return QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact);
+      case QJsonValue::Array: return QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact);
+      case QJsonValue::String: return quoted(value.toString());
+      case QJsonValue::Double:
+         // json has no nan or infinity, QJsonDocument writes them as null as well
+         if (!std::isfinite(value.toDouble())) return "null";
+         return QByteArray::number(value.toDouble(), 'g', QLocale::FloatingPointShortest);
+      case QJsonValue::Bool: return value.toBool() ? "true" : "false";
+      default: return "null";
+   }
+}
+
+void JsonStreamWriter::separate() {
+   // a value directly follows its key, everything else is separated from its predecessor
+   if (std::exchange(m_afterKey, false)) return;
+   if (m_first.empty()) return;
+   if (!m_first.back()) write(",");
+   m_first.back() = false;
+}
+
+void JsonStreamWriter::write(const QByteArray& data) {
+   m_failed |= m_device.write(data) != data.size();
+}
+
+JsonStreamReader::JsonStreamReader(QIODevice& device) : m_device(device) {}
+
+bool JsonStreamReader::enterObject() {
+   if (!expect('{')) return false;
+   m_first.push_back(true);
+   return true;
+}
+
+bool JsonStreamReader::nextKey(QString& key) {
+   if (m_error || m_first.empty()) return false;
+   if (peek() == '}') {
+      m_pos++;
+      m_first.pop_back();
+      return false;
+   }
+   if (!separate()) return false;
+
+   auto value = readValue();
+   if (!value.isString() || !expect(':')) {
+      m_error = true;
+      return false;
+   }
+   key = value.toString();
+   return true;
+}
+
+bool JsonStreamReader::enterArray() {
+   if (!expect('[')) return false;
+   m_first.push_back(true);
+   return true;
+}
+
+bool JsonStreamReader::nextElement() {
+   if (m_error || m_first.empty()) return false;
+   if (peek() == ']') {
+      m_pos++;
+      m_first.pop_back();
+      return false;
+   }
+   return separate();
+}
+
+QJsonValue JsonStreamReader::readValue() {
+   const auto raw = readRaw();
+   if (raw.isEmpty()) return {};
+
+   bool ok;
+   auto value = parse(raw, &ok);
+   m_error |= !ok;
+   return value;
+}
+
+void JsonStreamReader::skipValue() { readRaw(); }
+
+QJsonValue JsonStreamReader::parse(const QByteArray& raw, bool* ok) {
+   QJsonParseError error;
+   QJsonValue value;
+   if (raw.startsWith('{') || raw.startsWith('[')) {
+      auto document = QJsonDocument::fromJson(raw, &error);
+      value = document.isObject() ? QJsonValue(document.object()) : QJsonValue(document.array());
+   } else {
+      // scalars are no valid documents on their own
+      value = QJsonDocument::fromJson('[' + raw + ']', &error).array().first();
+   }
+
+   if (ok) *ok = error.error == QJsonParseError::NoError;
+   return value;
+}
+
+char JsonStreamReader::peek() {
+   // consumed data is dropped once in a while, values are read in one piece so this never cuts one
+   if (m_pos > CompactThreshold) {
+      m_buffer.remove(0, m_pos);
+      m_pos = 0;
+   }
+
+   while (true) {
+      while (m_pos < m_buffer.size() && isSpace(m_buffer[m_pos])) m_pos++;
+      if (m_pos < m_buffer.size()) return m_buffer[m_pos];
+      if (!fill()) return 0;
+   }
+}
+
+bool JsonStreamReader::expect(char c) {
+   if (peek() != c) {
+      m_error = true;
+      return false;
+   }
+   m_pos++;
+   return true;
+}
+
+bool JsonStreamReader::separate() {
+   if (std::exchange(m_first.back(), false)) return true;
+   return expect(',');
+}
+
+QByteArray JsonStreamReader::readRaw() {
+   const auto first = peek();
+   if (first == 0) {
+      m_error = true;
+      return {};
+   }
+
+   const auto start = m_pos;
+   auto end = start;
+   int depth = 0;
+   bool inString = false, escaped = false;
+   while (true) {
+      if (end == m_buffer.size() && !fill()) break;
+      const char c = m_buffer[end++];
+
+      if (inString) {
+         if (escaped) escaped = false;
+         else if (c == '\\') escaped = true;
+         else if (c == '"') {
+            inString = false;
+            if (depth == 0) break;
+         }
+      } else if (c == '"') {
+         inString = true;
+      } else if (c == '{' || c == '[') {
+         depth++;
+      } else if (c == '}' || c == ']') {
+         if (depth == 0) {
+            // the end of the enclosing container terminates a scalar
+            end--;
+            break;
+         }
+         if (--depth == 0) break;
+      } else if (depth == 0 && (c == ',' || c == ':' || isSpace(c))) {
+         end--;
+         break;
+      }
+   }
+
+   m_pos = end;
+   return m_buffer.mid(start, end - start);
+}
+
+bool JsonStreamReader::fill() {
+   const auto chunk = m_device.read(ChunkSize);
+   if (chunk.isEmpty()) return false;
+   m_buffer += chunk;
+   return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Common/Common.h"
+#include <QIODevice>
+#include <QJsonValue>
+#include <vector>
+
+/// Writes json token by token straight to a device, commas between the elements are inserted by
+/// the writer. Only values passed to value() are ever held in memory as a whole.
+class JsonStreamWriter {
+public:
+   explicit JsonStreamWriter(QIODevice& device);
+
+   void beginObject();
+   void endObject();
+   void beginArray();
+   void endArray();
+   void key(const QString& key);
+   void value(const QJsonValue& value);
+   /// Writes a value encoded beforehand, so the encoding can happen on other threads
+   void encodedValue(const QByteArray& json);
+
+   static QByteArray encode(const QJsonValue& value);
+
+   bool ok() const { return !m_failed; }
+
+private:
+   void separate();
+   void write(const QByteArray& data);
+
+private:
+   QIODevice& m_device;
+   std::vector<bool> m_first;// whether the open containers are still empty
+   bool m_afterKey = false;
+   bool m_failed = false;
+};
+
+/// Pulls json from a device piece by piece. Containers are entered and walked element by element,
+/// only the values read with readValue() are parsed as a whole.
+class JsonStreamReader {
+public:
+   explicit JsonStreamReader(QIODevice& device);
+
+   bool enterObject();
+   /// Reads the next key of the current object, false once the object ends
+   bool nextKey(QString& key);
+
+   bool enterArray();
+   /// Whether another element follows in the current array, false once the array ends
+   bool nextElement();
+
+   QJsonValue readValue();
+   void skipValue();
+   /// The next value as it is in the data, parse() turns it into json on any thread
+   QByteArray readRaw();
+   static QJsonValue parse(const QByteArray& raw, bool* ok = nullptr);
+
+   bool hasError() const { return m_error; }
+
+private:
+   /// Next character which is no whitespace, 0 at the end of the data
+   char peek();
+   bool expect(char c);
+   bool separate();
+   bool fill();
+
+private:
+   QIODevice& m_device;
+   QByteArray m_buffer;
+   qsizetype m_pos = 0;
+   std::vector<bool> m_first;
+   bool m_error = false;
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include "Common/Common.h"
+#include "Model/Components/MeshStream.h"
+#include <QJsonObject>
+#include <QVector2D>
+#include <QVector3D>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "packed streams are stored in native byte order");
+
+/// Scalar layout of the element types which can be packed
+template<typename T>
+struct PackedLayout;
+
+template<>
+struct PackedLayout<QVector3D> {
+   static constexpr auto Type = "float32";
+   static constexpr int Components = 3;
+};
+
+template<>
+struct PackedLayout<QVector2D> {
+   static constexpr auto Type = "float32";
+   static constexpr int Components = 2;
+};
+
+template<>
+struct PackedLayout<uint16_t> {
+   static constexpr auto Type = "uint16";
+   static constexpr int Components = 1;
+};
+
+/// Streams are packed into one json object holding the raw little endian elements as base64:
+/// {"type": "float32", "components": 3, "count": n, "stride": 12, "compressed": false, "data": ...}
+/// Payloads of at least CompressThreshold bytes are zlib compressed if that makes them smaller.
+struct PackedStream {
+   static constexpr qsizetype CompressThreshold = 4096;
+   static constexpr qsizetype DeferThreshold = 4096;
+
+   template<typename T>
+   static QJsonObject pack(const MeshStream<T>& stream) {
+      using Layout = PackedLayout<T>;
+      auto data = QByteArray::fromRawData(reinterpret_cast<const char*>(stream.data()),
+                                          qsizetype(stream.size() * sizeof(T)));
+      bool compressed = false;
+      if (data.size() >= CompressThreshold) {
+         auto packed = qCompress(data);
+         if (packed.size() < data.size()) {
+            data = std::move(packed);
+            compressed = true;
+         }
+      }
+
+      QJsonObject json;
+      json["type"] = Layout::Type;
+      json["components"] = Layout::Components;
+      json["count"] = qint64(stream.size());
+      json["stride"] = qint64(sizeof(T));
+      json["compressed"] = compressed;
+      json["data"] = QString::fromLatin1(data.toBase64());
+      return json;
+   }
+
+   /// False if the json is no packed stream of T or its data doesn't match the count
+   template<typename T>
+   static bool unpack(const QJsonObject& json, MeshStream<T>& stream) {
+      if (!matches<T>(json)) return false;
+      auto elements = decode<T>(payload(json), json["compressed"].toBool(),
+                                json["count"].toInteger());
+      if (!elements) return false;
+      stream = std::move(*elements);
+      return true;
+   }
+
+   /// Like unpack, but payloads of at least DeferThreshold bytes are only decoded when the stream
+   /// is first accessed. Until then the stream holds the raw payload, still compressed if it was
+   /// packed that way, instead of the much larger base64 text.
+   template<typename T>
+   static bool defer(const QJsonObject& json, MeshStream<T>& stream) {
+      const auto count = json["count"].toInteger();
+      if (count < 0 || count > std::numeric_limits<qint64>::max() / qint64(sizeof(T)) ||
+          count * qint64(sizeof(T)) < DeferThreshold) {
+         return unpack(json, stream);
+      }
+      if (!matches<T>(json)) return false;
+
+      // a payload which turns out to be broken leaves the stream empty
+      stream = MeshStream<T>::Deferred(count, [data = payload(json),
+                                               compressed = json["compressed"].toBool(), count] {
+         auto elements = decode<T>(data, compressed, count);
+         return elements ? MeshStream<T>(std::move(*elements)) : MeshStream<T>();
+      });
+      return true;
+   }
+
+private:
+   template<typename T>
+   static bool matches(const QJsonObject& json) {
+      using Layout = PackedLayout<T>;
+      static_assert(sizeof(T) % Layout::Components == 0);
+      if (json["type"].toString() != Layout::Type ||
+          json["components"].toInt() != Layout::Components ||
+          json["stride"].toInteger() != qint64(sizeof(T))) {
+         GS_DEBUG() << "Packed stream doesn't match" << Layout::Type << Layout::Components;
+         return false;
+      }
+      return true;
+   }
+
+   static QByteArray payload(const QJsonObject& json) {
+      return QByteArray::fromBase64(json["data"].toString().toLatin1());
+   }
+
+   template<typename T>
+   static std::optional<std::vector<T>> decode(QByteArray data, bool compressed, qint64 count) {
+      if (compressed) data = qUncompress(data);
+
+      if (count < 0 || count > std::numeric_limits<qint64>::max() / qint64(sizeof(T)) ||
+          data.size() != count * qint64(sizeof(T))) {
+         GS_DEBUG() << "Packed stream holds" << data.size() << "bytes for" << count << "elements";
+         return std::nullopt;
+      }
+
+      std::vector<T> elements(count);
+      if (count) std::memcpy(elements.data(), data.constData(), data.size());
+      return elements;
+   }
+};
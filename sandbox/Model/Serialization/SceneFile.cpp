@@ -0,0 +1,113 @@
+#include "SceneFile.h"
+#include "SceneJournal.h"
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+   /// Passes everything through to another device and reports the bytes which went through it.
+   /// Reads and writes fail once the progress asks to cancel.
+   class ProgressDevice : public QIODevice {
+   public:
+      ProgressDevice(QIODevice& device, qint64 total, const SceneFile::Progress& progress)
+         : m_device(device), m_total(total), m_progress(progress) {
+         // unbuffered, so positions and seeks match the device
+         open(device.openMode() | QIODevice::Unbuffered);
+      }
+
+      bool isSequential() const override { return m_device.isSequential(); }
+      qint64 size() const override { return m_device.size(); }
+      bool seek(qint64 pos) override { return QIODevice::seek(pos) && m_device.seek(pos); }
+
+   protected:
+      qint64 readData(char* data, qint64 size) override {
+         if (!report()) return -1;
+         const auto read = m_device.read(data, size);
+         m_done += std::max<qint64>(read, 0);
+         return read;
+      }
+
+      qint64 writeData(const char* data, qint64 size) override {
+         if (!report()) return -1;
+         const auto written = m_device.write(data, size);
+         m_done += std::max<qint64>(written, 0);
+         return written;
+      }
+
+   private:
+      bool report() {
+         m_cancelled = m_cancelled || (m_progress && !m_progress(m_done, m_total));
+         return !m_cancelled;
+      }
+
+   private:
+      QIODevice& m_device;
+      qint64 m_total;
+      qint64 m_done = 0;
+      const SceneFile::Progress& m_progress;
+      bool m_cancelled = false;
+   };
+}
+
+bool SceneFile::isBinary(const QString& path) {
+   return QFileInfo(path).suffix().compare(BinaryExtension, Qt::CaseInsensitive) == 0;
+}
+
+uptr<Scene> SceneFile::load(const QString& path, sptr<AssetStore> store, LoadMode mode,
+                            const Progress& progress, AssetProvider* assets) {
+   const auto total = QFileInfo(path).size();
+   const auto proceed = [&](qint64 done) { return !progress || progress(done, total); };
+
+   uptr<Scene> scene;
+   if (isBinary(path)) {
+      // mapped instead of read, so there is nothing to report until it's done. Compressed
+      // payloads are only decompressed once they are used, or below for eager loads.
+      BinaryReader reader;
+      if (!proceed(0) || !reader.open(path)) return nullptr;
+      scene = Scene::createFromBinary(reader, assets);
+   } else {
+      QFile file(path);
+      if (!file.open(QIODevice::ReadOnly)) {
+         GS_DEBUG() << "Couldn't open" << path;
+         return nullptr;
+      }
+      if (!store) store = AssetStore::forScene(path);
+      ProgressDevice device(file, total, progress);
+      JsonStreamReader reader(device);
+      scene = Scene::createFromJson(reader, store, assets);
+      // changes saved incrementally since the base was written
+      if (scene && !SceneJournal::replay(*scene, path, store, assets)) return nullptr;
+   }
+
+   if (scene && mode == LoadMode::Eager) scene->loadPayloads(assets);
+   if (!proceed(total)) return nullptr;
+   return scene;
+}
+
+bool SceneFile::save(const Scene& scene, const QString& path, sptr<AssetStore> store,
+                     const Progress& progress, BinaryArchive::Compression compression) {
+   // written next to the target and renamed at the end, scenes still mapping the old file keep it
+   QSaveFile file(path);
+   if (!file.open(QIODevice::WriteOnly)) {
+      GS_DEBUG() << "Couldn't open" << path;
+      return false;
+   }
+   // the size of the previous version is the best guess there is
+   ProgressDevice device(file, QFileInfo(path).size(), progress);
+
+   if (isBinary(path)) {
+      BinaryWriter writer(device, compression);
+      scene.write(writer);
+      if (!writer.finish()) {
+         file.cancelWriting();
+         return false;
+      }
+   } else {
+      JsonStreamWriter writer(device);
+      scene.write(writer, store ? store : AssetStore::forScene(path));
+      if (!writer.ok()) {
+         file.cancelWriting();
+         return false;
+      }
+   }
+   return file.commit();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Common/AssetStore.h"
+#include "BinaryArchive.h"
+#include "Model/Hierarchy/Scene.h"
+#include <QString>
+#include <functional>
+
+/// Loads and saves scenes, the format is picked by the extension: ".sceneb" files use the binary
+/// archive whose meshes and images are mapped instead of copied, or decompressed on first use if
+/// they were saved compressed. Everything else is json,
+/// which is streamed so no document of the whole scene is ever built. Json scenes keep their
+/// assets in a store, by default the one shared by all scenes of the same directory.
+class SceneFile {
+public:
+   static constexpr auto BinaryExtension = "sceneb";
+   static constexpr auto DialogFilter = "Scene Files (*.scene *.sceneb);;Json Scenes (*.scene);;"
+                                        "Binary Scenes (*.sceneb)";
+
+   /// Lazy loads only read the objects, hierarchy and small components up front. Large mesh
+   /// payloads and assets stay encoded, in the store or mapped until they are first used.
+   enum class LoadMode { Eager, Lazy };
+
+   /// Called with the bytes read or written so far and the expected total, 0 if it's unknown.
+   /// Returning false cancels: loads fail and saves leave the file as it was.
+   using Progress = std::function<bool(qint64 done, qint64 total)>;
+
+   static bool isBinary(const QString& path);
+
+   /// The assets are loaded into the given provider, the global one if it is null
+   static uptr<Scene> load(const QString& path, sptr<AssetStore> store = nullptr,
+                           LoadMode mode = LoadMode::Eager, const Progress& progress = {},
+                           AssetProvider* assets = nullptr);
+   /// Binary scenes are compressed unless compression is None, json ones compress their streams
+   /// on their own
+   static bool save(const Scene& scene, const QString& path, sptr<AssetStore> store = nullptr,
+                    const Progress& progress = {},
+                    BinaryArchive::Compression compression = BinaryArchive::Compression::Lz4);
+};
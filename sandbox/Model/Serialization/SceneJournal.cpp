@@ -0,0 +1,364 @@
+#include "SceneJournal.h"
+#include "Common/AssetProvider.h"
+#include "Common/JobSystem.h"
+#include "SceneFile.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <algorithm>
+#include <map>
+
+namespace {
+   /// Last state of every object changed in the journals, an empty delta means it was removed
+   struct JournalState {
+      std::vector<QUuid> order;
+      std::unordered_map<QUuid, QJsonObject, QtHasher<QUuid>> objects;
+      QJsonObject assets;
+
+      bool removed(const QUuid& id) const {
+         auto it = objects.find(id);
+         return it != objects.end() && it->second.isEmpty();
+      }
+   };
+
+   bool readJournal(const QString& path, JournalState& state) {
+      QFile file(path);
+      if (!file.exists()) return true;
+      if (!file.open(QIODevice::ReadOnly)) {
+         GS_DEBUG() << "Couldn't open" << path;
+         return false;
+      }
+
+      while (!file.atEnd()) {
+         const auto line = file.readLine();
+         if (line.trimmed().isEmpty()) continue;
+
+         QJsonParseError error;
+         const auto entry = QJsonDocument::fromJson(line, &error).object();
+         if (error.error != QJsonParseError::NoError) {
+            // only the last line can be broken, by a crash while it was appended
+            GS_DEBUG() << "Ignoring the rest of" << path << error.errorString();
+            break;
+         }
+
+         if (entry.contains("assets")) {
+            const auto assets = entry["assets"].toObject();
+            for (auto it = assets.begin(); it != assets.end(); ++it) state.assets[it.key()] = *it;
+            continue;
+         }
+
+         const bool removed = entry.contains("removed");
+         const auto id = QUuid::fromString(removed ? entry["removed"].toString()
+                                                   : entry["object"].toObject()["id"].toString());
+         if (id.isNull()) continue;
+         if (state.objects.insert_or_assign(id, removed ? QJsonObject() : entry).second) {
+            state.order.push_back(id);
+         }
+      }
+      return true;
+   }
+
+   QByteArray line(const QJsonObject& entry) {
+      return QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n';
+   }
+}
+
+SceneJournal::SceneJournal(Scene& scene, QString basePath, sptr<AssetStore> store, bool loaded)
+   : m_scene(scene), m_basePath(std::move(basePath)),
+     m_store(store ? std::move(store) : AssetStore::forScene(m_basePath)),
+     m_subscription(scene.subscribeObjects()), m_hasBase(loaded) {
+   if (!loaded) return;
+   const auto assets = AssetProvider::instance().ids();
+   m_savedAssets = {assets.begin(), assets.end()};
+}
+
+SceneJournal::~SceneJournal() {
+   waitForCompaction();
+   m_scene.unsubscribeObjects(m_subscription);
+}
+
+QString SceneJournal::journalPath(const QString& basePath) { return basePath + u".journal"_s; }
+
+QString SceneJournal::compactingPath(const QString& basePath) {
+   return basePath + u".journal.compacting"_s;
+}
+
+bool SceneJournal::appends() const {
+   // binary scenes have no journal, writing them in full is cheap since their blobs are raw
+   return m_hasBase && !SceneFile::isBinary(m_basePath);
+}
+
+bool SceneJournal::hasChanges() const {
+   if (!m_hasBase || m_scene.hasObjectChanges(m_subscription)) return true;
+   const auto assets = AssetProvider::instance().ids();
+   return std::ranges::any_of(assets, [this](uint64_t id) { return !m_savedAssets.contains(id); });
+}
+
+bool SceneJournal::save() {
+   if (!appends()) return saveBase();
+
+   const auto changes = m_scene.drainObjectChanges(m_subscription);
+   std::vector<uint64_t> assets;
+   for (const auto id: AssetProvider::instance().ids()) {
+      if (!m_savedAssets.contains(id)) assets.push_back(id);
+   }
+   if (changes.empty() && assets.empty()) return true;
+
+   // the deltas are serialized in parallel, every one is a line of its own
+   std::vector<QUuid> changed = changes.added;
+   changed.insert(changed.end(), changes.modified.begin(), changes.modified.end());
+   std::vector<QByteArray> lines(changed.size());
+   JobSystem::instance().parallelFor(changed.size(), 16, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+         auto obj = std::as_const(m_scene).findObject(changed[i]);
+         lines[i] = line(obj ? m_scene.objectDelta(**obj)
+                             : QJsonObject{{"removed", changed[i].toString()}});
+      }
+   });
+
+   QFile file(journalPath(m_basePath));
+   bool ok = file.open(QIODevice::WriteOnly | QIODevice::Append);
+   if (ok && !assets.empty()) {
+      JsonStreamWriter writer(file);
+      writer.beginObject();
+      writer.key("assets");
+      AssetProvider::instance().write(writer, m_store, assets);
+      writer.endObject();
+      ok = writer.ok() && file.write("\n") == 1;
+   }
+   for (const auto& id: changes.removed) {
+      ok = ok && file.write(line({{"removed", id.toString()}})) != -1;
+   }
+   for (const auto& entry: lines) ok = ok && file.write(entry) == entry.size();
+   ok = ok && file.flush();
+
+   if (!ok) {
+      // the drained changes would be lost, so the next save writes everything again
+      GS_DEBUG() << "Couldn't append to" << file.fileName();
+      m_hasBase = false;
+      return false;
+   }
+
+   m_savedAssets.insert(assets.begin(), assets.end());
+   if (file.size() > CompactThreshold) startCompaction();
+   return true;
+}
+
+bool SceneJournal::saveBase() {
+   // a running compaction would replace the new base with its own
+   waitForCompaction();
+   if (!SceneFile::save(m_scene, m_basePath, m_store)) return false;
+
+   discard(m_basePath);
+   m_scene.drainObjectChanges(m_subscription);
+   const auto assets = AssetProvider::instance().ids();
+   m_savedAssets = {assets.begin(), assets.end()};
+   m_hasBase = true;
+   return true;
+}
+
+void SceneJournal::startCompaction() {
+   if (m_compacting) return;
+   waitForCompaction();
+
+   // later saves go to a fresh journal while the full one is merged, a journal left over by a
+   // compaction which didn't finish is merged first
+   const auto compacting = compactingPath(m_basePath);
+   if (!QFile::exists(compacting) && !QFile::rename(journalPath(m_basePath), compacting)) return;
+
+   m_compacting = true;
+   m_compaction = std::thread([this, basePath = m_basePath] {
+      if (!compact(basePath)) GS_DEBUG() << "Couldn't compact" << basePath;
+      m_compacting = false;
+   });
+}
+
+void SceneJournal::waitForCompaction() {
+   if (m_compaction.joinable()) m_compaction.join();
+}
+
+void SceneJournal::discard(const QString& basePath) {
+   QFile::remove(journalPath(basePath));
+   QFile::remove(compactingPath(basePath));
+}
+
+bool SceneJournal::replay(Scene& scene, const QString& basePath, const sptr<AssetStore>& store,
+                          AssetProvider* assets) {
+   // a compacting journal is older than the current one, if it has been merged already
+   // replaying it again changes nothing since every entry holds a complete state
+   JournalState state;
+   if (!readJournal(compactingPath(basePath), state) || !readJournal(journalPath(basePath), state)) {
+      return false;
+   }
+   if (state.objects.empty() && state.assets.isEmpty()) return true;
+
+   (assets ? *assets : AssetProvider::instance()).fromJson(state.assets, store);
+   std::vector<QJsonObject> deltas;
+   std::vector<QUuid> removed;
+   for (const auto& id: state.order) {
+      const auto& delta = state.objects.at(id);
+      if (delta.isEmpty()) removed.push_back(id);
+      else deltas.push_back(delta);
+   }
+   scene.applyDeltas(deltas, removed);
+   return true;
+}
+
+bool SceneJournal::compact(const QString& basePath) {
+   JournalState state;
+   if (!readJournal(compactingPath(basePath), state)) return false;
+
+   // the changed objects are grouped the way the base stores them
+   std::vector<QJsonObject> objects;
+   std::map<QString, QJsonArray> children;
+   std::map<QString, std::vector<QJsonObject>> components;
+   for (const auto& id: state.order) {
+      const auto& delta = state.objects.at(id);
+      if (delta.isEmpty()) continue;
+      objects.push_back(delta["object"].toObject());
+      if (const auto parent = delta["parent"].toString(); !parent.isEmpty()) {
+         children[parent].append(id.toString());
+      }
+      const auto data = delta["components"].toObject();
+      for (auto it = data.begin(); it != data.end(); ++it) {
+         components[it.key()].push_back({{"id", id.toString()}, {"data", *it}});
+      }
+   }
+   const auto changed = [&](const QJsonValue& id) {
+      return state.objects.contains(QUuid::fromString(id.toString()));
+   };
+
+   QFile base(basePath);
+   if (!base.open(QIODevice::ReadOnly)) return false;
+   QSaveFile target(basePath);
+   if (!target.open(QIODevice::WriteOnly)) return false;
+   JsonStreamReader reader(base);
+   JsonStreamWriter writer(target);
+
+   // base and journal are merged section by section, unchanged elements are copied as they are
+   bool seenObjects = false, seenChildren = false, seenComponents = false, seenAssets = false;
+   const auto writeObjects = [&] {
+      for (const auto& obj: objects) writer.value(obj);
+   };
+   const auto writeChildren = [&] {
+      for (const auto& [parent, ids]: children) {
+         writer.key(parent);
+         writer.value(ids);
+      }
+   };
+   const auto writeComponents = [&] {
+      for (const auto& [type, elements]: components) {
+         writer.key(type);
+         writer.beginArray();
+         for (const auto& element: elements) writer.value(element);
+         writer.endArray();
+      }
+   };
+   const auto writeAssets = [&] {
+      for (auto it = state.assets.begin(); it != state.assets.end(); ++it) {
+         writer.key(it.key());
+         writer.value(*it);
+      }
+   };
+
+   QString key;
+   if (!reader.enterObject()) return false;
+   writer.beginObject();
+   while (reader.nextKey(key)) {
+      writer.key(key);
+      if (key == "objects" && reader.enterArray()) {
+         writer.beginArray();
+         while (reader.nextElement()) {
+            const auto raw = reader.readRaw();
+            if (!changed(JsonStreamReader::parse(raw).toObject()["id"])) writer.encodedValue(raw);
+         }
+         writeObjects();
+         writer.endArray();
+         seenObjects = true;
+      } else if (key == "children" && reader.enterObject()) {
+         writer.beginObject();
+         QString parent;
+         while (reader.nextKey(parent)) {
+            QJsonArray kept;
+            if (!reader.enterArray()) break;
+            while (reader.nextElement()) {
+               const auto child = reader.readValue();
+               if (!changed(child)) kept.append(child);
+            }
+            if (auto added = children.extract(parent)) {
+               for (const auto& child: added.mapped()) kept.append(child);
+            }
+            // children of removed objects have been removed with them
+            if (kept.isEmpty() || state.removed(QUuid::fromString(parent))) continue;
+            writer.key(parent);
+            writer.value(kept);
+         }
+         writeChildren();
+         writer.endObject();
+         seenChildren = true;
+      } else if (key == "components" && reader.enterObject()) {
+         writer.beginObject();
+         QString type;
+         while (reader.nextKey(type)) {
+            writer.key(type);
+            writer.beginArray();
+            if (!reader.enterArray()) break;
+            while (reader.nextElement()) {
+               const auto raw = reader.readRaw();
+               if (!changed(JsonStreamReader::parse(raw).toObject()["id"])) writer.encodedValue(raw);
+            }
+            if (auto added = components.extract(type)) {
+               for (const auto& element: added.mapped()) writer.value(element);
+            }
+            writer.endArray();
+         }
+         writeComponents();
+         writer.endObject();
+         seenComponents = true;
+      } else if (key == "assets" && reader.enterObject()) {
+         writer.beginObject();
+         QString id;
+         while (reader.nextKey(id)) {
+            const auto raw = reader.readRaw();
+            if (state.assets.contains(id)) continue;
+            writer.key(id);
+            writer.encodedValue(raw);
+         }
+         writeAssets();
+         writer.endObject();
+         seenAssets = true;
+      } else {
+         writer.encodedValue(reader.readRaw());
+      }
+   }
+
+   // sections the base doesn't have yet
+   if (!seenObjects) {
+      writer.key("objects");
+      writer.beginArray();
+      writeObjects();
+      writer.endArray();
+   }
+   const auto writeSection = [&](bool seen, const QString& name, const auto& write) {
+      if (seen) return;
+      writer.key(name);
+      writer.beginObject();
+      write();
+      writer.endObject();
+   };
+   writeSection(seenChildren, u"children"_s, writeChildren);
+   writeSection(seenComponents, u"components"_s, writeComponents);
+   writeSection(seenAssets, u"assets"_s, writeAssets);
+   writer.endObject();
+
+   if (reader.hasError() || !writer.ok()) {
+      GS_DEBUG() << "Couldn't merge the journal into" << basePath;
+      target.cancelWriting();
+      return false;
+   }
+   base.close();
+   if (!target.commit()) return false;
+   QFile::remove(compactingPath(basePath));
+   return true;
+}
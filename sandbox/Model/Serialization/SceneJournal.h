@@ -0,0 +1,66 @@
+#pragma once
+#include "Common/AssetStore.h"
+#include "Model/Hierarchy/Scene.h"
+#include <QString>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+
+/// Incremental saves of a json scene. The first save writes a full base snapshot, every later one
+/// only appends the objects and assets changed since to a journal next to it, one json document
+/// per line. Loading a base replays its journal. Once the journal grows past CompactThreshold it
+/// is merged into the base on a background thread, which only works on the files and never
+/// touches the live scene.
+class SceneJournal {
+public:
+   static constexpr qint64 CompactThreshold = 32 << 20;
+
+   /// When loaded the scene has just been loaded from basePath and the first save already appends
+   SceneJournal(Scene& scene, QString basePath, sptr<AssetStore> store = nullptr,
+                bool loaded = false);
+   ~SceneJournal();
+
+   SceneJournal(const SceneJournal&) = delete;
+   SceneJournal& operator=(const SceneJournal&) = delete;
+
+   /// Appends everything changed since the last save, the first save writes the base
+   bool save();
+
+   const QString& basePath() const { return m_basePath; }
+   /// Whether the next save only appends, otherwise it writes the whole scene
+   bool appends() const;
+   /// Whether a save would write anything, i.e. objects or assets changed since the last one
+   bool hasChanges() const;
+
+   /// Journal appended to by the saves and the one which is being merged into the base
+   static QString journalPath(const QString& basePath);
+   static QString compactingPath(const QString& basePath);
+
+   /// Removes the journals of a base which has just been written in full
+   static void discard(const QString& basePath);
+   /// Brings a scene loaded from the base up to date with its journals, the assets go into the
+   /// given provider or the global one
+   static bool replay(Scene& scene, const QString& basePath, const sptr<AssetStore>& store,
+                      AssetProvider* assets = nullptr);
+   /// Merges the compacting journal into the base
+   static bool compact(const QString& basePath);
+
+   /// Blocks until a running compaction has replaced the base, call it before the base is
+   /// written by anyone else
+   void waitForCompaction();
+
+private:
+   bool saveBase();
+   void startCompaction();
+
+private:
+   Scene& m_scene;
+   QString m_basePath;
+   sptr<AssetStore> m_store;
+   ChangeJournal::Subscription m_subscription;
+   std::unordered_set<uint64_t> m_savedAssets;
+   bool m_hasBase = false;
+
+   std::thread m_compaction;
+   std::atomic<bool> m_compacting = false;
+};
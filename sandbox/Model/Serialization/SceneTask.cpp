@@ -0,0 +1,68 @@
+#include "SceneTask.h"
+#include "SceneJournal.h"
+#include "Common/AssetProvider.h"
+#include <QThread>
+#include <algorithm>
+
+SceneTask::SceneTask(QString path, uptr<Scene> snapshot, std::function<bool(SceneTask&)> work)
+   : m_path(std::move(path)), m_snapshot(std::move(snapshot)), m_work(std::move(work)) {}
+
+SceneTask::~SceneTask() {
+   cancel();
+   if (m_worker.joinable()) m_worker.join();
+}
+
+uptr<SceneTask> SceneTask::load(QString path, SceneFile::LoadMode mode) {
+   return uptr<SceneTask>(new SceneTask(std::move(path), nullptr, [mode](SceneTask& task) {
+      task.m_assets = AssetProvider::createStaging();
+      const auto progress = [&task](qint64 done, qint64 total) { return task.report(done, total); };
+      auto scene = SceneFile::load(task.m_path, nullptr, mode, progress, task.m_assets.get());
+      if (!scene) return false;
+
+      // a QObject can only be pushed to another thread from the one it lives in
+      scene->moveAllToThread(task.thread());
+      task.m_scene = std::move(scene);
+      return true;
+   }));
+}
+
+uptr<SceneTask> SceneTask::save(uptr<Scene> snapshot, QString path, sptr<AssetStore> store) {
+   auto work = [store = std::move(store)](SceneTask& task) {
+      const bool ok = SceneFile::save(*task.m_snapshot, task.m_path, store,
+                                      [&task](qint64 done, qint64 total) {
+                                         return task.report(done, total);
+                                      });
+      if (ok) SceneJournal::discard(task.m_path);
+      return ok;
+   };
+   return uptr<SceneTask>(new SceneTask(std::move(path), std::move(snapshot), std::move(work)));
+}
+
+void SceneTask::start() {
+   if (m_worker.joinable()) return;
+   m_worker = std::thread([this] {
+      const bool ok = m_work(*this) && !m_cancelled;
+      m_progress = 1;
+      emit finished(ok);
+   });
+}
+
+uptr<Scene> SceneTask::takeScene() {
+   // the worker is done once it has emitted finished()
+   if (m_worker.joinable()) m_worker.join();
+   if (m_scene && m_assets) AssetProvider::instance().merge(*m_assets);
+   m_assets.reset();
+   return std::move(m_scene);
+}
+
+bool SceneTask::report(qint64 done, qint64 total) {
+   // a save can write more than the previous version of the file had, so it never reaches 1 early
+   const double progress = total > 0 ? std::min(double(done) / double(total), 0.99) : -1;
+   m_progress = progress;
+   const int perMille = progress < 0 ? -1 : int(progress * 1000);
+   if (perMille != m_reported) {
+      m_reported = perMille;
+      emit progressChanged(progress);
+   }
+   return !m_cancelled;
+}
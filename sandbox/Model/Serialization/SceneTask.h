@@ -0,0 +1,61 @@
+#pragma once
+#include "SceneFile.h"
+#include <QObject>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/// Loads or saves a scene on a worker thread, so the window keeps running meanwhile. Progress and
+/// cancellation are shared with the worker through atomics, the signals are delivered on the
+/// thread which owns the task. Tasks are created idle, so they can be connected before start().
+class SceneTask : public QObject {
+   Q_OBJECT
+
+public:
+   /// The scene is built on the worker and handed to the thread of the task once it is done. Its
+   /// assets are loaded into a staging provider until then, so the current scene keeps its own.
+   static uptr<SceneTask> load(QString path, SceneFile::LoadMode mode = SceneFile::LoadMode::Lazy);
+   /// Saves a snapshot taken with Scene::clone(), the scene itself can keep changing meanwhile.
+   /// Journals of an older version of the file are discarded once it has been written.
+   static uptr<SceneTask> save(uptr<Scene> snapshot, QString path,
+                               sptr<AssetStore> store = nullptr);
+
+   /// Cancels the task and waits for the worker
+   ~SceneTask() override;
+
+   SceneTask(const SceneTask&) = delete;
+   SceneTask& operator=(const SceneTask&) = delete;
+
+   void start();
+
+   const QString& path() const { return m_path; }
+   bool isSave() const { return m_snapshot != nullptr; }
+
+   void cancel() { m_cancelled = true; }
+   bool isCancelled() const { return m_cancelled; }
+   /// Between 0 and 1, negative as long as the total size is unknown
+   double progress() const { return m_progress; }
+
+   /// The loaded scene once finished() was emitted, null if the load failed or was cancelled.
+   /// Merges the staged assets into the global provider, so it's called where the scene is used.
+   uptr<Scene> takeScene();
+
+signals:
+   void progressChanged(double progress);
+   void finished(bool ok);
+
+private:
+   SceneTask(QString path, uptr<Scene> snapshot, std::function<bool(SceneTask&)> work);
+   bool report(qint64 done, qint64 total);
+
+private:
+   QString m_path;
+   uptr<Scene> m_snapshot;
+   uptr<Scene> m_scene;
+   uptr<AssetProvider> m_assets;
+   std::function<bool(SceneTask&)> m_work;
+   std::thread m_worker;
+   std::atomic<bool> m_cancelled = false;
+   std::atomic<double> m_progress = 0;
+   int m_reported = -1;// last reported per mille, only touched by the worker
+};
@@ -0,0 +1,43 @@
+#include "SystemScheduler.h"
+
+SystemScheduler::SystemScheduler(JobSystem& jobs) : m_jobs(jobs) {}
+
+void SystemScheduler::add(QString name, SystemAccess access, Run run) {
+   m_systems.push_back({std::move(name), access, std::move(run)});
+   m_stagesDirty = true;
+}
+
+void SystemScheduler::run(Scene& scene) {
+   for (const auto& stage: stages()) {
+      if (stage.size() == 1) {
+         m_systems[stage.front()].run(scene, m_jobs);
+         continue;
+      }
+
+      JobCounter counter;
+      for (auto index: stage) {
+         m_jobs.submit([this, index, &scene] { m_systems[index].run(scene, m_jobs); }, counter);
+      }
+      m_jobs.wait(counter);
+   }
+}
+
+const std::vector<std::vector<size_t> >& SystemScheduler::stages() {
+   if (m_stagesDirty) rebuildStages();
+   return m_stages;
+}
+
+void SystemScheduler::rebuildStages() {
+   std::vector<size_t> stageOf(m_systems.size(), 0);
+   m_stages.clear();
+   for (size_t i = 0; i < m_systems.size(); ++i) {
+      for (size_t j = 0; j < i; ++j) {
+         if (m_systems[i].access.conflicts(m_systems[j].access)) {
+            stageOf[i] = std::max(stageOf[i], stageOf[j] + 1);
+         }
+      }
+      if (stageOf[i] >= m_stages.size()) m_stages.resize(stageOf[i] + 1);
+      m_stages[stageOf[i]].push_back(i);
+   }
+   m_stagesDirty = false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "Common/Common.h"
+#include "Common/JobSystem.h"
+#include "Model/Hierarchy/SceneQuery.h"
+#include <functional>
+#include <vector>
+
+class Scene;
+
+/// Component types a system reads and writes
+struct SystemAccess {
+   ComponentsMask reads;
+   ComponentsMask writes;
+
+   bool conflicts(const SystemAccess& other) const {
+      return (writes & (other.reads | other.writes)).any() || (reads & other.writes).any();
+   }
+};
+
+/// Runs per-frame systems over a scene. Systems are grouped into stages in the order they were
+/// added, a system joins the first stage after every earlier system it conflicts with, so systems
+/// without conflicting access run concurrently. Systems may only touch components, creating
+/// objects, components or queries while a stage runs is not allowed.
+class SystemScheduler {
+public:
+   using Run = std::function<void(Scene&, JobSystem&)>;
+
+   explicit SystemScheduler(JobSystem& jobs = JobSystem::instance());
+
+   void add(QString name, SystemAccess access, Run run);
+   void run(Scene& scene);
+
+   const std::vector<std::vector<size_t> >& stages();
+
+private:
+   struct System {
+      QString name;
+      SystemAccess access;
+      Run run;
+   };
+
+   void rebuildStages();
+
+private:
+   JobSystem& m_jobs;
+   std::vector<System> m_systems;
+   std::vector<std::vector<size_t> > m_stages;
+   bool m_stagesDirty = false;
+};
@@ -3,6 +3,7 @@
 #include "Model/Components/CameraComponent.h"
 #include "Model/Components/MaterialComponent.h"
 #include "Model/Components/MeshComponent.h"
+#include "Model/Math/TransformMath.h"
 
 #include <QOpenGLTexture>
 #include <QSurface>
@@ -18,8 +19,24 @@ OpenGLRenderer::~OpenGLRenderer() {
    delete m_indexBuffer;
 }
 
-void OpenGLRenderer::setScene(Scene* scene) {
-   m_scene = scene;
+void OpenGLRenderer::setSnapshots(RenderSnapshotBuffer* snapshots) {
+   m_snapshots = snapshots;
+   m_snapshot.reset();
+}
+
+void OpenGLRenderer::prepareSnapshot() {
+   m_snapshot = m_snapshots->acquire();
+   // releases GPU resources the extractor doesn't need anymore while the context is current
+   m_snapshots->takeRetired();
+   if (!m_snapshot) return;
+
+   // shared copies stay clean, only new or changed ones get uploaded
+   for (const auto& draw: m_snapshot->draws) {
+      if (draw.mesh->isDirty()) draw.mesh->prepare(program(draw.material.get()));
+      if (draw.material && draw.material->isDirty()) {
+         draw.material->prepare(program(draw.material.get()));
+      }
+   }
 }
 
 void OpenGLRenderer::init() {
@@ -48,25 +65,25 @@ void OpenGLRenderer::render() {
    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+   if (!m_snapshots) return;
+   prepareSnapshot();
+   if (!m_snapshot) return;
+
    if (m_lastStage <= 1) return;
 
    if (m_editorCam && m_editorTrans) {
-      renderCamera(*m_editorCam, *m_editorTrans);
+      renderCamera(*m_editorCam, m_editorTrans->modelMatrix());
    } else {
-      for (auto& [_, cam]: m_scene->components<CameraComponent>()) {
-         if (!cam.parent().enabled()) continue;
-
-         renderCamera(cam, cam.parent().getComponent<TransformComponent>());
-      }
+      for (const auto& [camera, model]: m_snapshot->cameras) { renderCamera(camera, model); }
    }
 }
 
-void OpenGLRenderer::renderCamera(const CameraComponent& camera, const TransformComponent& transform) {
+void OpenGLRenderer::renderCamera(const CameraComponent& camera, const QMatrix4x4& cameraModel) {
    QRect viewport = drawBackground(camera);
    if (m_lastStage <= 2) return;
-   drawScene(camera, transform, viewport);
+   drawScene(camera, cameraModel, viewport);
 }
-void OpenGLRenderer::drawScene(const CameraComponent& camera, const TransformComponent& transform, const QRect& viewport) {
+void OpenGLRenderer::drawScene(const CameraComponent& camera, const QMatrix4x4& cameraModel, const QRect& viewport) {
    if (camera.wireframe) {
       glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
    } else {
@@ -74,16 +91,12 @@ void OpenGLRenderer::drawScene(const CameraComponent& camera, const TransformCom
    }
 
    QMatrix4x4 projection = camera.projectionMatrix(float(viewport.width()) / float(viewport.height()));
-   QMatrix4x4 view = transform.modelMatrix().inverted();
+   QMatrix4x4 view = TransformMath::inverseAffine(cameraModel);
 
    // Draw scene
    glViewport(viewport.x(), viewport.y(), viewport.width(), viewport.height());
-   for (auto& [_, mesh]: m_scene->components<MeshComponent>()) {
-      if (!mesh.parent().enabled()) continue;
-
-      auto& meshTransform = mesh.parent().getComponent<TransformComponent>();
-      QMatrix4x4 model = meshTransform.modelMatrix();
-      drawObject(model, view, projection, &mesh.parent());
+   for (const auto& draw: m_snapshot->draws) {
+      drawObject(draw.model, view, projection, *draw.mesh, draw.material.get());
    }
 }
 
@@ -120,14 +133,13 @@ void OpenGLRenderer::setLastStage(int stage) {
    m_lastStage = stage;
 }
 
-void OpenGLRenderer::drawObject(QMatrix4x4 model, QMatrix4x4 view, QMatrix4x4 projection, Object* obj) {
-   auto& mesh = obj->getComponent<MeshComponent>();
-   auto* prgm = program(obj);
+void OpenGLRenderer::drawObject(QMatrix4x4 model, QMatrix4x4 view, QMatrix4x4 projection,
+                                MeshComponent& mesh, MaterialComponent* material) {
+   auto* prgm = program(material);
 
    // setting up the shader program
    m_vao->bind();
    prgm->bind();
-   mesh.prepare(prgm);
    mesh.bind(prgm);
 
    // bind uniform data for all shaders
@@ -136,11 +148,7 @@ void OpenGLRenderer::drawObject(QMatrix4x4 model, QMatrix4x4 view, QMatrix4x4 pr
    prgm->setUniformValue("projection", projection);
 
    // bind shader specific uniform data
-   if (obj->hasComponent<MaterialComponent>()) {
-      auto& material = obj->getComponent<MaterialComponent>();
-      material.prepare(prgm);
-      material.bind(prgm);
-   }
+   if (material) { material->bind(prgm); }
 
    glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_SHORT, nullptr);
 
@@ -148,10 +156,7 @@ void OpenGLRenderer::drawObject(QMatrix4x4 model, QMatrix4x4 view, QMatrix4x4 pr
    mesh.release(prgm);
 
    // release shader specific uniform data
-   if (obj->hasComponent<MaterialComponent>()) {
-      auto& material = obj->getComponent<MaterialComponent>();
-      material.release(prgm);
-   }
+   if (material) { material->release(prgm); }
 }
 
 const std::optional<CameraComponent>& OpenGLRenderer::editorCam() const {
@@ -170,11 +175,10 @@ void OpenGLRenderer::setEditorTrans(const std::optional<TransformComponent>& edi
    m_editorTrans = editorTrans;
 }
 
-QOpenGLShaderProgram* OpenGLRenderer::program(Object* obj) {
-   auto shaders = ShaderProvider::instance().getShaders();
-   if (obj->hasComponent<MaterialComponent>() && shaders.contains(obj->getComponent<MaterialComponent>().shader)) {
-      auto shader = obj->getComponent<MaterialComponent>().shader;
-      return shaders.at(shader);
+QOpenGLShaderProgram* OpenGLRenderer::program(const MaterialComponent* material) {
+   const auto& shaders = ShaderProvider::instance().getShaders();
+   if (material) {
+      if (auto it = shaders.find(material->shader); it != shaders.end()) return it->second;
    }
-   return ShaderProvider::instance().getShaders().at("Default");
+   return shaders.at("Default");
 }
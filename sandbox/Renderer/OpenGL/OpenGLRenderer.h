@@ -1,7 +1,8 @@
 #pragma once
 #include "Model/Components/CameraComponent.h"
 #include "Model/Components/MeshComponent.h"
-#include "Model/Hierarchy/Scene.h"
+#include "Model/Components/MaterialComponent.h"
+#include "Renderer/RenderSnapshot.h"
 #include <QObject>
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions_3_3_Core>
@@ -19,7 +20,7 @@ public:
 public slots:
    void init();
 
-   void setScene(Scene* scene);
+   void setSnapshots(RenderSnapshotBuffer* snapshots);
    void render();
    void resize(int w, int h);
 
@@ -34,18 +35,22 @@ public slots:
    void setEditorTrans(const std::optional<TransformComponent>& editorTrans);
 
 private:
-   void renderCamera(const CameraComponent& camera, const TransformComponent& transform);
-   void drawObject(QMatrix4x4 model, QMatrix4x4 view, QMatrix4x4 projection, Object* obj);
+   void prepareSnapshot();
+   void renderCamera(const CameraComponent& camera, const QMatrix4x4& cameraModel);
+   void drawObject(QMatrix4x4 model, QMatrix4x4 view, QMatrix4x4 projection, MeshComponent& mesh,
+                   MaterialComponent* material);
 
 private:
-   Scene* m_scene = nullptr;
+   // the renderer never reads the live scene, only the latest snapshot
+   RenderSnapshotBuffer* m_snapshots = nullptr;
+   sptr<const RenderSnapshot> m_snapshot;
    int m_lastStage = std::numeric_limits<int>::max();
    int m_width = 0;
    int m_height = 0;
 
    std::optional<CameraComponent> m_editorCam;
    std::optional<TransformComponent> m_editorTrans;
-   static QOpenGLShaderProgram* program(Object* obj);
+   static QOpenGLShaderProgram* program(const MaterialComponent* material);
 
    QOpenGLVertexArrayObject* m_vao = nullptr;
    QOpenGLBuffer* m_vertexBuffer = nullptr;
@@ -53,5 +58,5 @@ private:
    std::vector<QOpenGLTexture*> m_textures = {};
 
    QRect drawBackground(const CameraComponent& camera);
-   void drawScene(const CameraComponent& camera, const TransformComponent& transform, const QRect& viewport);
+   void drawScene(const CameraComponent& camera, const QMatrix4x4& cameraModel, const QRect& viewport);
 };
@@ -0,0 +1,124 @@
+#include "RenderExtractor.h"
+#include "Model/Hierarchy/Object.h"
+
+RenderExtractor::RenderExtractor(RenderSnapshotBuffer& buffer) : m_buffer(buffer) {
+   // both only read components, so they run concurrently
+   m_systems.add("Extract cameras",
+                 {.reads = componentsMask<CameraComponent, TransformComponent>()},
+                 [this](Scene& scene, JobSystem&) { extractCameras(scene); });
+   m_systems.add("Extract meshes",
+                 {.reads = componentsMask<MeshComponent, MaterialComponent, TransformComponent>()},
+                 [this](Scene& scene, JobSystem& jobs) { extractMeshes(scene, jobs); });
+}
+
+RenderExtractor::~RenderExtractor() {
+   setScene(nullptr);
+}
+
+void RenderExtractor::setScene(Scene* scene) {
+   if (m_scene) {
+      m_scene->unsubscribe<MeshComponent>(m_meshChanges);
+      m_scene->unsubscribe<MaterialComponent>(m_materialChanges);
+   }
+   clear();
+
+   m_scene = scene;
+   if (m_scene) {
+      m_meshChanges = m_scene->subscribe<MeshComponent>();
+      m_materialChanges = m_scene->subscribe<MaterialComponent>();
+   }
+}
+
+void RenderExtractor::extract() {
+   auto snapshot = std::make_shared<RenderSnapshot>();
+   snapshot->frame = m_frame++;
+   if (!m_scene) {
+      m_buffer.publish(std::move(snapshot));
+      return;
+   }
+
+   // copies of changed components are dropped, they are copied again once they are drawn
+   evict(m_meshes, m_scene->drainChanges<MeshComponent>(m_meshChanges));
+   evict(m_materials, m_scene->drainChanges<MaterialComponent>(m_materialChanges));
+
+   // matrices and queries are prepared up front, the systems must not change the scene
+   m_scene->updateTransforms();
+   m_scene->query<CameraComponent, TransformComponent>();
+   m_scene->query<MeshComponent, TransformComponent>();
+
+   m_building = std::move(snapshot);
+   m_systems.run(*m_scene);
+   m_buffer.publish(std::move(m_building));
+}
+
+void RenderExtractor::extractCameras(Scene& scene) {
+   for (auto [camera, transform]: scene.query<CameraComponent, TransformComponent>()) {
+      if (!camera.parent().enabled()) continue;
+      m_building->cameras.push_back({camera, transform.modelMatrix()});
+      m_building->cameras.back().camera.detach();
+   }
+}
+
+void RenderExtractor::extractMeshes(Scene& scene, JobSystem& jobs) {
+   auto& meshes = scene.query<MeshComponent, TransformComponent>();
+   const auto& entries = meshes.entries();
+
+   // the matrices are the expensive part, sharing the copies has to stay on one thread
+   std::vector<std::optional<QMatrix4x4> > models(entries.size());
+   jobs.parallelFor(entries.size(), 256, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i) {
+         if (!entries[i].object->enabled()) continue;
+         models[i] = std::get<1>(meshes.resolve(entries[i])).modelMatrix();
+      }
+   });
+
+   m_building->draws.reserve(entries.size());
+   for (size_t i = 0; i < entries.size(); ++i) {
+      if (!models[i]) continue;
+
+      auto& mesh = std::get<0>(meshes.resolve(entries[i]));
+      auto* material = scene.findComponent<MaterialComponent>(entries[i].object);
+      m_building->draws.push_back({*models[i], share(m_meshes, mesh),
+                                   material ? share(m_materials, *material) : nullptr});
+   }
+
+   // payloads of lazily loaded scenes are decoded for the visible meshes only, all at once
+   // here instead of one after another when the renderer prepares them
+   std::vector<const MeshComponent*> pending;
+   for (const auto& draw: m_building->draws) {
+      if (!draw.mesh->isPayloadLoaded()) pending.push_back(draw.mesh.get());
+   }
+   jobs.parallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i) pending[i]->loadPayload();
+   });
+}
+
+template <typename T>
+void RenderExtractor::evict(Cache<T>& cache, const ChangeSet& changes) {
+   for (const auto& ids: {&changes.modified, &changes.removed}) {
+      for (const auto& id: *ids) {
+         auto it = cache.find(id);
+         if (it == cache.end()) continue;
+         m_buffer.retire(std::move(it->second));
+         cache.erase(it);
+      }
+   }
+}
+
+template <typename T>
+sptr<T> RenderExtractor::share(Cache<T>& cache, const T& component) {
+   auto& shared = cache[component.parent().id()];
+   if (!shared) {
+      // the copy outlives the object once the render side gets its own thread
+      shared = std::make_shared<T>(component);
+      shared->detach();
+   }
+   return shared;
+}
+
+void RenderExtractor::clear() {
+   for (auto& [_, mesh]: m_meshes) m_buffer.retire(std::move(mesh));
+   for (auto& [_, material]: m_materials) m_buffer.retire(std::move(material));
+   m_meshes.clear();
+   m_materials.clear();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Model/Hierarchy/Scene.h"
+#include "Model/Systems/SystemScheduler.h"
+#include "RenderSnapshot.h"
+#include <QPointer>
+#include <unordered_map>
+
+/// Captures the live scene into immutable render snapshots. Runs on the thread owning the scene,
+/// unchanged meshes and materials are shared with the previous snapshot instead of being copied.
+class RenderExtractor {
+public:
+   explicit RenderExtractor(RenderSnapshotBuffer& buffer);
+   ~RenderExtractor();
+
+   void setScene(Scene* scene);
+   void extract();
+
+private:
+   template <typename T>
+   using Cache = std::unordered_map<QUuid, sptr<T>, QtHasher<QUuid> >;
+
+   template <typename T>
+   void evict(Cache<T>& cache, const ChangeSet& changes);
+
+   template <typename T>
+   static sptr<T> share(Cache<T>& cache, const T& component);
+
+   void extractCameras(Scene& scene);
+   void extractMeshes(Scene& scene, JobSystem& jobs);
+   void clear();
+
+private:
+   RenderSnapshotBuffer& m_buffer;
+   QPointer<Scene> m_scene;
+   ChangeJournal::Subscription m_meshChanges = 0;
+   ChangeJournal::Subscription m_materialChanges = 0;
+   Cache<MeshComponent> m_meshes;
+   Cache<MaterialComponent> m_materials;
+   uint64_t m_frame = 0;
+   SystemScheduler m_systems;
+   sptr<RenderSnapshot> m_building;
+};
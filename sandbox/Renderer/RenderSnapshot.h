@@ -0,0 +1,70 @@
+#pragma once
+#include "Common/Common.h"
+#include "Model/Components/CameraComponent.h"
+#include "Model/Components/MaterialComponent.h"
+#include "Model/Components/MeshComponent.h"
+#include <QMatrix4x4>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/// Everything the renderer needs from a scene for one frame. Meshes and materials are shared
+/// between consecutive snapshots as long as they don't change, they are detached copies of the
+/// scene's components and only the render side touches them since it owns their GPU resources.
+struct RenderSnapshot {
+   struct Camera {
+      CameraComponent camera;
+      QMatrix4x4 model;
+   };
+
+   struct Draw {
+      QMatrix4x4 model;
+      sptr<MeshComponent> mesh;
+      sptr<MaterialComponent> material;
+   };
+
+   uint64_t frame = 0;
+   std::vector<Camera> cameras;
+   std::vector<Draw> draws;
+};
+
+/// Hands snapshots from the thread which extracts them to the thread which renders them.
+/// The extracting side always builds a new back buffer and publishing swaps it to the front,
+/// the render side keeps the front it acquired until it asks for the next one. For now
+/// OpenGLView does both on the GUI thread, the renderer hasn't got a thread of its own yet.
+class RenderSnapshotBuffer {
+public:
+   void publish(sptr<const RenderSnapshot> snapshot) {
+      std::lock_guard lock(m_mutex);
+      // the old front may hold the last reference to GPU resources
+      if (m_front) m_retired.push_back(std::exchange(m_front, std::move(snapshot)));
+      else m_front = std::move(snapshot);
+   }
+
+   sptr<const RenderSnapshot> acquire() const {
+      std::lock_guard lock(m_mutex);
+      return m_front;
+   }
+
+   /// Keeps data alive until the render side releases it, GPU resources must be deleted there
+   void retire(sptr<const void> data) {
+      std::lock_guard lock(m_mutex);
+      m_retired.push_back(std::move(data));
+   }
+
+   std::vector<sptr<const void> > takeRetired() {
+      std::lock_guard lock(m_mutex);
+      return std::exchange(m_retired, {});
+   }
+
+   void clear() {
+      std::lock_guard lock(m_mutex);
+      m_front.reset();
+      m_retired.clear();
+   }
+
+private:
+   mutable std::mutex m_mutex;
+   sptr<const RenderSnapshot> m_front;
+   std::vector<sptr<const void> > m_retired;
+};
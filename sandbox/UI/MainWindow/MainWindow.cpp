@@ -1,13 +1,20 @@
 #include "MainWindow.h"
 #include "Common/ShaderProvider.h"
+#include "Model/Serialization/SceneFile.h"
+#include "Model/Serialization/SceneJournal.h"
+#include "Model/Serialization/SceneTask.h"
 #include "UI/View/OpenGL/OpenGLView.h"
 #include "ui_mainwindow.h"
 #include <QFileDialog>
-#include <QJsonDocument>
+#include <QTimer>
 #include <qscreen.h>
 #include <QWindow>
 #include <QStyleFactory>
 
+namespace {
+   constexpr int AutosaveInterval = 30000;
+}
+
 MainWindow::MainWindow(QWidget* parent)
    : QMainWindow(parent), m_ui(new Ui::MainWindow) {
    setAttribute(Qt::WA_NativeWindow);
@@ -21,10 +28,29 @@ MainWindow::MainWindow(QWidget* parent)
    connect(m_ui->saveScene, &QAction::triggered, this, &MainWindow::saveScene);
    m_ui->newScene->setShortcut(QKeySequence::New);
    connect(m_ui->newScene, &QAction::triggered, [this] {
-      m_scene = Scene::createEmpty();
-      m_ui->sceneBrowser->setScene(m_scene.get());
-      m_view->setScene(m_scene.get());
+      m_queuedLoad.reset();
+      setScene(Scene::createEmpty());
+   });
+
+   // scenes which have a file are saved incrementally to their journal
+   auto* autosave = new QTimer(this);
+   connect(autosave, &QTimer::timeout, this, &MainWindow::autosave);
+   autosave->start(AutosaveInterval);
+
+   // loads and saves run in the background, they can be cancelled from the status bar
+   m_progress = new QProgressBar(this);
+   m_progress->setRange(0, 1000);
+   m_progress->setMaximumWidth(200);
+   m_progress->setTextVisible(false);
+   m_progress->hide();
+   m_cancel = new QToolButton(this);
+   m_cancel->setText("Cancel");
+   m_cancel->hide();
+   connect(m_cancel, &QToolButton::clicked, [this] {
+      if (m_task) m_task->cancel();
    });
+   m_ui->statusbar->addPermanentWidget(m_progress);
+   m_ui->statusbar->addPermanentWidget(m_cancel);
 
    connect(m_ui->sceneBrowser, &SceneBrowser::objectSelected, m_ui->objectEditor,
            &ObjectEditor::setObject);
@@ -42,13 +68,7 @@ MainWindow::MainWindow(QWidget* parent)
               });
    });
 
-   if (QFile::exists("test/test.scene")) {
-      QFile file("test/test.scene");
-      file.open(QIODevice::ReadOnly);
-      m_scene = Scene::createFromJson(QJsonDocument::fromJson(file.readAll()).object());
-      m_ui->sceneBrowser->setScene(m_scene.get());
-      m_view->setScene(m_scene.get());
-   }
+   if (QFile::exists("test/test.scene")) { startLoad("test/test.scene", false); }
 
    int currentScreenFps = window()->screen()->refreshRate();
    m_view->setFpsTarget(currentScreenFps);
@@ -111,28 +131,126 @@ void MainWindow::buildUI() {
 }
 
 void MainWindow::loadScene() {
-   auto filename = QFileDialog::getOpenFileName(this, "Open Scene", "", "Scene Files (*.scene)");
+   auto filename = QFileDialog::getOpenFileName(this, "Open Scene", "", SceneFile::DialogFilter);
    if (filename.isEmpty()) { return; }
 
-   QFile file(filename);
-   file.open(QIODevice::ReadOnly);
-   QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-   file.close();
-
-   auto scene = Scene::createFromJson(doc.object());
-   m_ui->sceneBrowser->setScene(scene.get());
-   m_view->setScene(scene.get());
-   m_scene = std::move(scene);
+   startLoad(filename, true);
 }
 
 void MainWindow::saveScene() {
-   auto filename = QFileDialog::getSaveFileName(this, "Save Scene", "", "Scene Files (*.scene)");
+   auto filename = QFileDialog::getSaveFileName(this, "Save Scene", "", SceneFile::DialogFilter);
    if (filename.isEmpty()) { return; }
 
-   QFile file(filename);
-   file.open(QIODevice::WriteOnly);
-   file.write(QJsonDocument(m_scene->toJson()).toJson(QJsonDocument::JsonFormat::Compact));
-   file.close();
+   // saving to the file of the journal only appends the changes since its last save
+   if (m_journal && m_journal->basePath() == filename && m_journal->appends()) {
+      if (!m_journal->save()) {
+         m_ui->statusbar->showMessage(QString("Couldn't save %1").arg(filename), 5000);
+      }
+      return;
+   }
+   startSave(filename);
+}
+
+void MainWindow::autosave() {
+   // scenes without changes aren't written again, binary ones would be written in full
+   if (!m_journal || m_task || !m_journal->hasChanges()) return;
+   if (!m_journal->appends()) {
+      startSave(m_journal->basePath());
+   } else if (!m_journal->save()) {
+      m_ui->statusbar->showMessage(QString("Couldn't save %1").arg(m_journal->basePath()), 5000);
+   }
+}
+
+void MainWindow::startLoad(const QString& path, bool keepSaving) {
+   if (m_task && m_task->isSave()) {
+      m_queuedLoad = QueuedLoad{path, keepSaving};
+      m_ui->statusbar->showMessage(
+            QString("Loading %1 once %2 is saved").arg(path).arg(m_task->path()), 5000);
+      return;
+   }
+   // payloads are only loaded once the view or the editor needs them
+   startTask(SceneTask::load(path), [this, keepSaving](SceneTask& task) {
+      setScene(task.takeScene());
+      if (keepSaving) {
+         m_journal = std::make_unique<SceneJournal>(*m_scene, task.path(), nullptr, true);
+      }
+   });
+}
+
+void MainWindow::startSave(const QString& path) {
+   // the snapshot is written while the scene keeps changing, a new journal records those changes
+   // from the moment the snapshot was taken and takes over once the file is written
+   auto journal = std::make_unique<SceneJournal>(*m_scene, path, nullptr, true);
+   // a compaction of the old journal would replace the new file with the older state it merged
+   if (m_journal && m_journal->basePath() == path) m_journal->waitForCompaction();
+   const bool started = startTask(SceneTask::save(m_scene->clone(), path), [this](SceneTask&) {
+      m_journal = std::move(m_pendingJournal);
+   });
+   if (!started) return;
+   // the old journal of the file must not append to it while it is rewritten
+   if (m_journal && m_journal->basePath() == path) m_journal.reset();
+   m_pendingJournal = std::move(journal);
+}
+
+bool MainWindow::startTask(uptr<SceneTask> task, std::function<void(SceneTask&)> done) {
+   if (m_task && m_task->isSave()) {
+      m_ui->statusbar->showMessage(QString("Still saving %1").arg(m_task->path()), 5000);
+      return false;
+   }
+   // a running load is abandoned, its signals are dropped together with it
+   m_task.reset();
+
+   // the task is the context, so its queued signals are delivered on this thread
+   auto* raw = task.get();
+   connect(raw, &SceneTask::progressChanged, raw, [this](double progress) {
+      if (progress < 0) {
+         m_progress->setRange(0, 0);
+      } else {
+         m_progress->setRange(0, 1000);
+         m_progress->setValue(int(progress * 1000));
+      }
+   });
+   connect(raw, &SceneTask::finished, raw, [this, done = std::move(done)](bool ok) {
+      auto task = std::move(m_task);
+      m_progress->hide();
+      m_cancel->hide();
+      m_ui->statusbar->clearMessage();
+
+      if (ok) {
+         done(*task);
+      } else {
+         if (task->isSave()) m_pendingJournal.reset();
+         const auto action = task->isSave() ? "save" : "load";
+         const auto message = task->isCancelled() ? QString("Cancelled %1 of %2")
+                                                  : QString("Couldn't %1 %2");
+         m_ui->statusbar->showMessage(message.arg(action).arg(task->path()), 5000);
+      }
+      // it can't be destroyed while it is emitting
+      task.release()->deleteLater();
+
+      if (m_queuedLoad) {
+         const auto load = *std::exchange(m_queuedLoad, std::nullopt);
+         startLoad(load.path, load.keepSaving);
+      }
+   });
+
+   const auto action = raw->isSave() ? "Saving" : "Loading";
+   m_ui->statusbar->showMessage(QString("%1 %2").arg(action).arg(raw->path()));
+   m_progress->setRange(0, 1000);
+   m_progress->setValue(0);
+   m_progress->show();
+   m_cancel->show();
+   m_task = std::move(task);
+   m_task->start();
+   return true;
+}
+
+void MainWindow::setScene(uptr<Scene> scene) {
+   m_journal.reset();
+   m_pendingJournal.reset();
+   m_ui->sceneBrowser->setScene(scene.get());
+   m_view->setScene(scene.get());
+   m_scene = std::move(scene);
 }
 
 void MainWindow::buildFpsMenu() {
@@ -4,7 +4,13 @@
 #include "UI/View/ViewBase.h"
 #include "Model/Model.h"
 #include <QMainWindow>
+#include <QProgressBar>
 #include <QSplitter>
+#include <QToolButton>
+#include <optional>
+
+class SceneJournal;
+class SceneTask;
 
 namespace Ui {
    class MainWindow;
@@ -24,8 +30,31 @@ private slots:
    void saveScene();
    void buildFpsMenu();
 
+private:
+   void setScene(uptr<Scene> scene);
+   void autosave();
+   /// A load requested while a save is running is started once the save is done
+   void startLoad(const QString& path, bool keepSaving);
+   void startSave(const QString& path);
+   /// Runs the task in the background and calls done once it succeeded. Only one task runs at a
+   /// time: a running load is cancelled, while a save is running the new task isn't started.
+   bool startTask(uptr<SceneTask> task, std::function<void(SceneTask&)> done);
+
 private:
    Ui::MainWindow* m_ui = nullptr;
    ViewBase* m_view = nullptr;
+   QProgressBar* m_progress = nullptr;
+   QToolButton* m_cancel = nullptr;
    uptr<Scene> m_scene = Scene::createEmpty();
+   // saves of the scene file it belongs to, destroyed before the scene it watches
+   uptr<SceneJournal> m_journal;
+   // records the changes made while a full save is written, then replaces m_journal
+   uptr<SceneJournal> m_pendingJournal;
+   uptr<SceneTask> m_task;
+   struct QueuedLoad {
+      QString path;
+      bool keepSaving;
+   };
+   // only the last load requested during a save is kept
+   std::optional<QueuedLoad> m_queuedLoad;
 };
\ No newline at end of file
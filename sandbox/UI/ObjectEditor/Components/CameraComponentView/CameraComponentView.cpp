@@ -29,6 +29,7 @@ CameraComponentView::CameraComponentView(QWidget* parent)
          if (color.isValid()) {
             auto& camera = m_obj->getComponent<CameraComponent>();
             camera.backgroundColor = color;
+            camera.dirty();
             m_ui->color->setStyleSheet(QStringLiteral("background-color: %1").arg(color.name(QColor::HexRgb)));
             emit objectChanged();
          }
@@ -36,6 +37,7 @@ CameraComponentView::CameraComponentView(QWidget* parent)
       if (diag.exec() == QDialog::Rejected) {
          auto& camera = m_obj->getComponent<CameraComponent>();
          camera.backgroundColor = colorBefore;
+         camera.dirty();
          m_ui->color->setStyleSheet(QStringLiteral("background-color: %1").arg(colorBefore.name(QColor::HexRgb)));
          emit objectChanged();
       }
@@ -66,6 +68,7 @@ void CameraComponentView::updateValues() {
    camera.farClip = m_ui->far->value();
    camera.viewport = viewport;
    camera.wireframe = m_ui->wireframe->isChecked();
+   camera.dirty();
 
    m_ui->fovValue->setText(QString::number(camera.fov) + QStringLiteral("°"));
 
@@ -48,4 +48,5 @@ void DirectionLightSourceComponentView::updateValues() {
    comp.intensity = m_ui->intensitySpinBox->value();
    comp.shadowType.type = static_cast<ShadowType::Type>(m_ui->shadowComboBox->currentIndex());
    comp.color = m_ui->colorFrame->pixmap().toImage().pixelColor(0, 0);
+   comp.dirty();
 }
\ No newline at end of file
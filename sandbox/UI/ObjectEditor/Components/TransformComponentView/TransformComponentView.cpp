@@ -46,6 +46,7 @@ void TransformComponentView::updateValues() {
    transform.position = position;
    transform.rotation = QQuaternion::fromEulerAngles(rotation);
    transform.scale = scale;
+   transform.dirty();
 
    emit objectChanged();
 }
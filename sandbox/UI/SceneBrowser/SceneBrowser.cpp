@@ -9,7 +9,6 @@
 #include <ranges>
 #include <QMimeData>
 #include <QTimer>
-#include <unordered_set>
 
 #include "Importer/AssimpImporter.h"
 
@@ -55,21 +54,8 @@ void SceneBrowser::rebuild() {
    m_items.clear();
    m_ui->list->clear();
 
-   // check order consistency
-   std::unordered_set<uint64_t> orders;
-   uint64_t maxOrder = 0;
-   for (auto* obj: m_scene->objects()) {
-      if (orders.contains(obj->order())) { obj->setOrder(maxOrder + 1); }
-      orders.insert(obj->order());
-      maxOrder = std::max(maxOrder, obj->order());
-   }
-
-   // rebuild items
-   auto objectsView = m_scene->objects()
-                      | std::views::filter([](Object* obj) { return !obj->parent(); });
-   auto objects = std::vector(objectsView.begin(), objectsView.end());
-   std::ranges::sort(objects, [](Object* a, Object* b) { return a->order() < b->order(); });
-   for (auto* obj: objects) {
+   // rebuild items, the scene keeps siblings sorted
+   for (auto* obj: m_scene->orderedChildrenOf(nullptr)) {
       const auto item = createItemForObject(obj);
       m_ui->list->addTopLevelItem(item);
    }
@@ -112,9 +98,7 @@ QTreeWidgetItem* SceneBrowser::createItemForObject(Object* obj) {
    item->setText(0, obj->name());
    item->setData(0, Qt::UserRole, obj->id());
 
-   auto children = obj->children();
-   std::ranges::sort(children, [](Object* a, Object* b) { return a->order() < b->order(); });
-   for (auto* child: children) {
+   for (auto* child: m_scene->orderedChildrenOf(obj)) {
       auto childItem = createItemForObject(child);
       item->addChild(childItem);
    }
@@ -122,23 +106,13 @@ QTreeWidgetItem* SceneBrowser::createItemForObject(Object* obj) {
    return item;
 }
 
-QTreeWidgetItem* SceneBrowser::lastItemBefore(QTreeWidgetItem* item) {
-   QTreeWidgetItem* lastWatched = nullptr;
-   std::function<bool(QTreeWidgetItem*)> findLast;
-   findLast = [&](QTreeWidgetItem* current) {
-      if (current == item) return true;
-      lastWatched = current;
-      for (int i = 0; i < current->childCount(); ++i) {
-         if (findLast(current->child(i))) { return true; }
-      }
-      return false;
-   };
-
-   for (int topLevelI = 0; topLevelI < m_ui->list->topLevelItemCount(); ++topLevelI) {
-      if (findLast(m_ui->list->topLevelItem(topLevelI))) { return lastWatched; }
+QTreeWidgetItem* SceneBrowser::previousSibling(QTreeWidgetItem* item) {
+   if (auto* parent = item->parent()) {
+      const auto index = parent->indexOfChild(item);
+      return index > 0 ? parent->child(index - 1) : nullptr;
    }
-
-   return nullptr;
+   const auto index = m_ui->list->indexOfTopLevelItem(item);
+   return index > 0 ? m_ui->list->topLevelItem(index - 1) : nullptr;
 }
 
 bool SceneBrowser::eventFilter(QObject* watched, QEvent* event) {
@@ -263,28 +237,11 @@ void SceneBrowser::handleDropEvent(QDropEvent* event) {
          return;
       }
 
-      auto droppedObjGlobalTrans = (*droppedObject)->getComponent<TransformComponent>().toGlobal();
-
       // identify its parent
       auto droppedItemParent = droppedItem->parent();
-      auto droppedObjectOrder = (*droppedObject)->order();
-      uint64_t newOrder = 0;
+      Object* newParent = nullptr;
       if (!droppedItemParent) {
          GS_DEBUG() << "Dropped object has no parent";
-         (*droppedObject)->unsetParent();
-
-         if (m_ui->list->indexOfTopLevelItem(droppedItem) > 0) {
-            if (const auto* lastItemBeforeOurs = lastItemBefore(droppedItem)) {
-               newOrder = (*m_scene->findObject(
-                                lastItemBeforeOurs->data(0, Qt::UserRole).value<QUuid>()))->order()
-                          + 1;
-            }
-         }
-
-         auto& droppedObjTrans = (*droppedObject)->getComponent<TransformComponent>();
-         droppedObjTrans.position = droppedObjGlobalTrans.position;
-         droppedObjTrans.rotation = droppedObjGlobalTrans.rotation;
-         droppedObjTrans.scale = droppedObjGlobalTrans.scale;
       } else {
          auto parentID = droppedItemParent->data(0, Qt::UserRole).value<QUuid>();
          auto parentObject = m_scene->findObject(parentID);
@@ -292,55 +249,27 @@ void SceneBrowser::handleDropEvent(QDropEvent* event) {
             GS_DEBUG() << "Couldn't find parent object";
             return;
          }
-
-         // cycle detection
-         if (droppedID == parentID) {
-            GS_DEBUG() << "Dropped onto itself, borting";
-            rebuild();
-            emit sceneChanged();
-            return;
-         }
-
-         auto allChildren = m_scene->allChildrenOf(**droppedObject);
-         if (std::ranges::find(allChildren, *parentObject) != allChildren.end()) {
-            GS_DEBUG() << "Cycle detected, borting";
-            rebuild();
-            emit sceneChanged();
-            return;
-         }
-
-         m_scene->addChild(**parentObject, **droppedObject);
-
-         if (const auto* lastItemBeforeOurs = lastItemBefore(droppedItem)) {
-            // it must have an item before because it has a parent!
-            newOrder = (*m_scene->findObject(
-                             lastItemBeforeOurs->data(0, Qt::UserRole).value<QUuid>()))->order() +
-                       1;
-         } else { qFatal() << "Couldn't find last item before dropped item"; }
-
-         auto& droppedObjTrans = (*droppedObject)->getComponent<TransformComponent>();
-         auto localTrans = droppedObjTrans.fromGlobal(droppedObjGlobalTrans);
-         droppedObjTrans.position = localTrans.position;
-         droppedObjTrans.rotation = localTrans.rotation;
-         droppedObjTrans.scale = localTrans.scale;
+         newParent = *parentObject;
       }
 
-      // shift up
-      for (auto* obj: m_scene->objects()) {
-         if (obj->order() >= newOrder && obj->id() != droppedID) {
-            obj->setOrder(obj->order() + 1);
-         }
+      // keeps the world placement under the new parent
+      Object* dropped[] = {*droppedObject};
+      if (!m_scene->reparent(dropped, newParent, true)) {
+         GS_DEBUG() << "Cycle detected, borting";
+         rebuild();
+         emit sceneChanged();
+         return;
       }
 
-      // set new order
-      (*droppedObject)->setOrder(newOrder);
-
-      // close gaps
-      uint64_t order = 0;
-      auto orderedObjects = m_scene->objects();
-      std::ranges::sort(orderedObjects,
-                        [](Object* a, Object* b) { return a->order() < b->order(); });
-      for (auto* obj: orderedObjects) { obj->setOrder(order++); }
+      // only the dropped object gets a new order, placed behind the sibling it was dropped after
+      const Object* previous = nullptr;
+      if (const auto* previousItem = previousSibling(droppedItem)) {
+         const auto previousObject =
+               m_scene->findObject(previousItem->data(0, Qt::UserRole).value<QUuid>());
+         if (previousObject) previous = *previousObject;
+         else GS_DEBUG() << "Couldn't find previous sibling, placing the object first";
+      }
+      m_scene->placeAfter(**droppedObject, previous);
 
       rebuild();
       emit sceneChanged();
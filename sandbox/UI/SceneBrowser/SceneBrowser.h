@@ -33,7 +33,7 @@ private slots:
 
 private:
    QTreeWidgetItem* createItemForObject(Object* obj);
-   QTreeWidgetItem* lastItemBefore(QTreeWidgetItem* item);
+   QTreeWidgetItem* previousSibling(QTreeWidgetItem* item);
 
 private:
    Ui::SceneBrowser* m_ui = nullptr;
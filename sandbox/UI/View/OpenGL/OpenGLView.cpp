@@ -33,6 +33,9 @@ OpenGLView::OpenGLView(QWidget* parent)
 OpenGLView::~OpenGLView() {
    makeCurrent();
    delete m_renderer;
+   // the shared mesh copies own GPU buffers, so they have to go while the context is current
+   m_extractor.setScene(nullptr);
+   m_snapshots.clear();
    doneCurrent();
 }
 
@@ -43,7 +46,7 @@ int OpenGLView::fpsTarget() const { return m_fpsTarget; }
 void OpenGLView::initializeGL() {
    m_renderer = new OpenGLRenderer(context());
    m_renderer->init();
-   m_renderer->setScene(m_scene);
+   m_renderer->setSnapshots(&m_snapshots);
    if (m_inspectionCamera) {
       m_renderer->setEditorTrans(m_editorTrans);
       m_renderer->setEditorCam(m_editorCam);
@@ -80,6 +83,9 @@ void OpenGLView::paintGL() {
 
    // Capture timestamp before and after rendering to calculate render time
    const auto before = std::chrono::high_resolution_clock::now();
+   // extracting and rendering both block the GUI thread, editor rebuilds still stall a frame.
+   // The snapshots don't reference the scene, a render thread would only replace render() here.
+   m_extractor.extract();
    m_renderer->render();
    const auto now = std::chrono::high_resolution_clock::now();
 
@@ -105,7 +111,7 @@ void OpenGLView::setFpsTarget(int target) {
 
 void OpenGLView::setScene(Scene* scene) {
    m_scene = scene;
-   if (m_renderer) { m_renderer->setScene(m_scene); }
+   m_extractor.setScene(m_scene);
 }
 
 bool OpenGLView::eventFilter(QObject* watched, QEvent* ev) {
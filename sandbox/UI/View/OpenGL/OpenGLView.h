@@ -1,6 +1,7 @@
 #pragma once
 #include "Model/Hierarchy/Scene.h"
 #include "Renderer/OpenGL/OpenGLRenderer.h"
+#include "Renderer/RenderExtractor.h"
 #include "UI/View/ViewBase.h"
 #include <QOpenGLWidget>
 #include <QTimer>
@@ -51,6 +52,8 @@ private:
    std::chrono::high_resolution_clock::time_point m_lastRenderTime;
    OpenGLRenderer* m_renderer = nullptr;
    Scene* m_scene = nullptr;
+   RenderSnapshotBuffer m_snapshots;
+   RenderExtractor m_extractor = RenderExtractor(m_snapshots);
    bool m_editorCamRotating = false;
    float m_speed = .2f;
    float m_mouseSpeed = .2f;
@@ -0,0 +1,182 @@
+#include "Model/Serialization/BinaryArchive.h"
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+#include <cstddef>
+#include <cstring>
+#include <random>
+
+/// Blobs read back the same whether they were compressed or not, corrupt block indices are
+/// rejected before anything is allocated for them and archives of the first version still open
+class BinaryArchiveTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void init() {
+      QVERIFY(m_dir.isValid());
+      m_path = m_dir.filePath("test.sceneb");
+   }
+
+   void blobsRoundTrip_data() {
+      QTest::addColumn<int>("size");
+      QTest::addColumn<int>("scalarSize");
+      QTest::addColumn<bool>("repetitive");
+      QTest::newRow("below the threshold") << 100 << 1 << true;
+      QTest::newRow("one block") << 65536 << 1 << true;
+      QTest::newRow("one byte block") << 65537 << 1 << true;
+      QTest::newRow("whole blocks of floats") << 3 * 65536 << 4 << true;
+      // the bytes after the last whole scalar aren't shuffled
+      QTest::newRow("partial scalar") << 65536 + 4099 << 4 << true;
+      QTest::newRow("vectors") << 100003 << 12 << true;
+      QTest::newRow("incompressible") << 200000 << 1 << false;
+   }
+
+   void blobsRoundTrip() {
+      QFETCH(int, size);
+      QFETCH(int, scalarSize);
+      QFETCH(bool, repetitive);
+
+      const auto data = sample(size, scalarSize, repetitive);
+      const auto ref = write(data, scalarSize, BinaryArchive::Compression::Lz4);
+      QCOMPARE(ref.compressed, uint64_t(size) >= BinaryArchive::CompressThreshold);
+
+      BinaryReader reader;
+      QVERIFY(reader.open(m_path));
+      QCOMPARE(reader.size(ref), uint64_t(size));
+      std::vector<uchar> read(size);
+      QVERIFY(reader.unpacker(ref)(read.data()));
+      QVERIFY(read == data);
+      if (!ref.compressed) {
+         QVERIFY(reader.blob(ref) && std::memcmp(reader.blob(ref), data.data(), size) == 0);
+         return;
+      }
+
+      // blocks which don't get smaller are stored as they are behind the index
+      const auto blocks = (uint64_t(size) + BinaryArchive::BlockSize - 1) /
+                          BinaryArchive::BlockSize;
+      const auto index = sizeof(BinaryArchive::CompressedBlob) + blocks * sizeof(uint64_t);
+      if (repetitive) QVERIFY(ref.size < uint64_t(size) / 4);
+      else QCOMPARE(ref.size, index + size);
+      QVERIFY(!reader.blob(ref));
+   }
+
+   void emptyBlobsAreNotWritten() {
+      const auto ref = write({}, 1, BinaryArchive::Compression::Lz4);
+      QCOMPARE(ref.size, uint64_t(0));
+
+      BinaryReader reader;
+      QVERIFY(reader.open(m_path));
+      QCOMPARE(reader.size(ref), uint64_t(0));
+      QVERIFY(!reader.blob(ref));
+   }
+
+   void corruptBlobsAreRejected_data() {
+      // offsets into the CompressedBlob header, the block ends start right after it
+      QTest::addColumn<int>("offset");
+      QTest::addColumn<quint64>("value");
+      QTest::addColumn<int>("width");
+      QTest::newRow("magic") << 0 << quint64(0x58585858) << 4;
+      QTest::newRow("no block size") << 4 << quint64(0) << 4;
+      QTest::newRow("huge block size") << 4 << (quint64(1) << 30) << 4;
+      QTest::newRow("size beyond the blocks") << 8 << quint64(3 * 65536 + 1) << 8;
+      QTest::newRow("huge size") << 8 << (quint64(1) << 40) << 8;
+      QTest::newRow("more blocks") << 16 << quint64(4) << 4;
+      QTest::newRow("no scalar size") << 20 << quint64(0) << 4;
+      QTest::newRow("block end past the blob") << 32 << (quint64(1) << 40) << 8;
+      QTest::newRow("block ends backwards") << 40 << quint64(32) << 8;
+      QTest::newRow("short block") << 32 << quint64(32 + 3 * 8 + 10) << 8;
+   }
+
+   void corruptBlobsAreRejected() {
+      QFETCH(int, offset);
+      QFETCH(quint64, value);
+      QFETCH(int, width);
+
+      const int size = 3 * 65536;
+      const auto ref = write(sample(size, 4, true), 4, BinaryArchive::Compression::Lz4);
+      QVERIFY(ref.compressed);
+      patch(qint64(ref.offset) + offset, value, width);
+
+      BinaryReader reader;
+      QVERIFY(reader.open(m_path));
+      const auto claimed = reader.size(ref);
+      QVERIFY(claimed <= uint64_t(size));
+      std::vector<uchar> read(size);
+      QVERIFY(claimed == 0 || !reader.unpacker(ref)(read.data()));
+   }
+
+   void blobsOutsideTheFileAreRejected() {
+      const auto data = sample(100, 1, true);
+      write(data, 1, BinaryArchive::Compression::None);
+      const auto fileSize = uint64_t(QFileInfo(m_path).size());
+
+      BinaryReader reader;
+      QVERIFY(reader.open(m_path));
+      std::vector<uchar> read(100);
+      for (const auto& ref: {BlobRef{fileSize + 64, 100}, BlobRef{64, fileSize},
+                             BlobRef{64, ~uint64_t(0)}, BlobRef{fileSize + 64, 100, true}}) {
+         QVERIFY(!reader.blob(ref));
+         QCOMPARE(reader.size(ref), ref.compressed ? uint64_t(0) : ref.size);
+         QVERIFY(!reader.unpacker(ref)(read.data()));
+      }
+   }
+
+   void firstVersionArchivesStillOpen() {
+      // the first version had the same layout, only without compressed blobs
+      const auto data = sample(10000, 1, true);
+      const auto ref = write(data, 1, BinaryArchive::Compression::None);
+      patch(offsetof(BinaryArchive::Header, version), 1, 4);
+
+      BinaryReader reader;
+      QVERIFY(reader.open(m_path));
+      QVERIFY(reader.beginSection(Tag));
+      BlobRef recorded;
+      reader.record() >> recorded;
+      QCOMPARE(recorded.offset, ref.offset);
+      QVERIFY(reader.blob(recorded));
+      QVERIFY(std::memcmp(reader.blob(recorded), data.data(), data.size()) == 0);
+
+      // newer versions may have changed anything
+      patch(offsetof(BinaryArchive::Header, version), BinaryArchive::Version + 1, 4);
+      QVERIFY(!BinaryReader().open(m_path));
+   }
+
+private:
+   static constexpr SectionTag Tag = {'T', 'E', 'S', 'T'};
+
+   /// Archive with the blob and a section which records where it is
+   BlobRef write(const std::vector<uchar>& data, int scalarSize,
+                 BinaryArchive::Compression compression) const {
+      QFile file(m_path);
+      if (!file.open(QIODevice::WriteOnly)) return {};
+      BinaryWriter writer(file, compression);
+      const auto ref = writer.blob(data.data(), data.size(), uint32_t(scalarSize));
+      writer.beginSection(Tag);
+      writer.record() << ref;
+      return writer.finish() ? ref : BlobRef();
+   }
+
+   /// Overwrites width bytes of the file with the lowest ones of value
+   void patch(qint64 position, quint64 value, int width) const {
+      QFile file(m_path);
+      QVERIFY(file.open(QIODevice::ReadWrite));
+      QVERIFY(file.seek(position));
+      QCOMPARE(file.write(reinterpret_cast<const char*>(&value), width), qint64(width));
+   }
+
+   /// Repetitive data is made of scalars whose bytes differ but recur every 16 KiB
+   static std::vector<uchar> sample(int size, int scalarSize, bool repetitive) {
+      std::mt19937 random(3);
+      std::vector<uchar> data(size);
+      for (int i = 0; i < size; ++i) {
+         data[i] = repetitive ? uchar((i / 64) * 31 + i % scalarSize) : uchar(random());
+      }
+      return data;
+   }
+
+   QTemporaryDir m_dir;
+   QString m_path;
+};
+
+QTEST_GUILESS_MAIN(BinaryArchiveTest)
+#include "BinaryArchiveTest.moc"
@@ -0,0 +1,189 @@
+#include "Model/Components/CameraComponent.h"
+#include "Model/Hierarchy/Object.h"
+#include "Model/Hierarchy/Scene.h"
+#include <QTest>
+#include <algorithm>
+
+/// Sparse-set storage, component handles, change journals and the views and queries on top
+class ComponentsRegistryTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void eraseKeepsDenseArrayPacked() {
+      ComponentsRegistry<CameraComponent> registry;
+      const QUuid a = QUuid::createUuid(), b = QUuid::createUuid(), c = QUuid::createUuid();
+      registry.emplace(a, nullptr).fov = 1;
+      registry.emplace(b, nullptr).fov = 2;
+      registry.emplace(c, nullptr).fov = 3;
+      // adding an id twice returns the existing component
+      QCOMPARE(registry.emplace(b, nullptr).fov, 2.0f);
+      QCOMPARE(registry.size(), size_t(3));
+
+      // the last component is swapped into the hole
+      registry.erase(a);
+      QCOMPARE(registry.size(), size_t(2));
+      QVERIFY(!registry.contains(a));
+      QCOMPARE(registry.find(b)->fov, 2.0f);
+      QCOMPARE(registry.find(c)->fov, 3.0f);
+      QCOMPARE(registry.ids(), (std::vector<QUuid>{c, b}));
+      QCOMPARE(registry.dense()[0].fov, 3.0f);
+
+      registry.erase(a);
+      QCOMPARE(registry.size(), size_t(2));
+   }
+
+   void handlesSurviveMovesButNotRemovals() {
+      ComponentsRegistry<CameraComponent> registry;
+      const QUuid a = QUuid::createUuid(), b = QUuid::createUuid();
+      registry.emplace(a, nullptr);
+      registry.emplace(b, nullptr).fov = 7;
+      const auto handleA = registry.handle(a);
+      const auto handleB = registry.handle(b);
+      QVERIFY(handleA.valid() && handleB.valid());
+      QVERIFY(!registry.handle(QUuid::createUuid()).valid());
+
+      // b is moved to the front of the dense array, its handle still finds it
+      registry.erase(a);
+      QVERIFY(registry.get(handleA) == nullptr);
+      QCOMPARE(registry.get(handleB), registry.find(b));
+      QCOMPARE(registry.get(handleB)->fov, 7.0f);
+
+      // the freed slot is reused with a new generation
+      const QUuid c = QUuid::createUuid();
+      registry.emplace(c, nullptr);
+      const auto handleC = registry.handle(c);
+      QCOMPARE(handleC.slot, handleA.slot);
+      QVERIFY(handleC.generation != handleA.generation);
+      QVERIFY(registry.get(handleA) == nullptr);
+      QVERIFY(registry.get(handleC) != nullptr);
+   }
+
+   void journalRecordsOnlyWithSubscribers() {
+      ChangeJournal journal;
+      journal.record(QUuid::createUuid(), ChangeKind::Added);
+      const auto subscription = journal.subscribe();
+      QVERIFY(journal.drain(subscription).empty());
+   }
+
+   void journalCoalescesPerId() {
+      ChangeJournal journal;
+      const auto subscription = journal.subscribe();
+      const QUuid added = QUuid::createUuid(), transient = QUuid::createUuid();
+      const QUuid removed = QUuid::createUuid(), replaced = QUuid::createUuid();
+      const QUuid modified = QUuid::createUuid();
+
+      journal.record(added, ChangeKind::Added);
+      journal.record(added, ChangeKind::Modified);
+      journal.record(transient, ChangeKind::Added);
+      journal.record(transient, ChangeKind::Removed);
+      journal.record(removed, ChangeKind::Modified);
+      journal.record(removed, ChangeKind::Removed);
+      journal.record(replaced, ChangeKind::Removed);
+      journal.record(replaced, ChangeKind::Added);
+      journal.record(modified, ChangeKind::Modified);
+      journal.record(modified, ChangeKind::Modified);
+
+      const auto changes = journal.drain(subscription);
+      QCOMPARE(changes.added, std::vector<QUuid>{added});
+      QCOMPARE(changes.removed, std::vector<QUuid>{removed});
+      QCOMPARE(changes.modified, (std::vector<QUuid>{replaced, modified}));
+
+      // everything has been seen
+      QVERIFY(journal.drain(subscription).empty());
+   }
+
+   void journalSubscribersDrainIndependently() {
+      ChangeJournal journal;
+      const auto first = journal.subscribe();
+      const QUuid a = QUuid::createUuid(), b = QUuid::createUuid();
+      journal.record(a, ChangeKind::Added);
+      const auto second = journal.subscribe();
+      journal.record(b, ChangeKind::Added);
+
+      QCOMPARE(journal.drain(first).added, (std::vector<QUuid>{a, b}));
+      QCOMPARE(journal.drain(second).added, std::vector<QUuid>{b});
+
+      // a freed subscription is handed out again and starts at the end
+      journal.unsubscribe(first);
+      journal.record(a, ChangeKind::Modified);
+      QCOMPARE(journal.subscribe(), first);
+      QVERIFY(journal.drain(first).empty());
+      QCOMPARE(journal.drain(second).modified, std::vector<QUuid>{a});
+      QVERIFY(journal.drain(42).empty());
+   }
+
+   void viewsAndQueriesFollowComponents() {
+      auto scene = Scene::createEmpty();
+      std::vector<Object*> objects;
+      for (int i = 0; i < 4; ++i) {
+         auto obj = Object::create(*scene);
+         objects.push_back(obj.get());
+         scene->addObject(std::move(obj));
+      }
+      objects[1]->addComponent<CameraComponent>();
+      objects[3]->addComponent<CameraComponent>();
+
+      auto& query = scene->query<CameraComponent, TransformComponent>();
+      QCOMPARE(viewed(*scene), sorted({objects[1], objects[3]}));
+      QCOMPARE(queried(query), sorted({objects[1], objects[3]}));
+
+      // removals move components around, the query keeps resolving the right ones
+      objects[1]->removeComponent<CameraComponent>();
+      objects[0]->addComponent<CameraComponent>().fov = 10;
+      objects[3]->getComponent<CameraComponent>().fov = 30;
+      QCOMPARE(viewed(*scene), sorted({objects[0], objects[3]}));
+      QCOMPARE(queried(query), sorted({objects[0], objects[3]}));
+      for (auto [camera, transform]: query) {
+         QCOMPARE(camera.fov, &camera.parent() == objects[0] ? 10.0f : 30.0f);
+      }
+
+      scene->removeObject(*objects[3]);
+      QCOMPARE(queried(query), std::vector<Object*>{objects[0]});
+   }
+
+   void componentChangesAreJournaled() {
+      auto scene = Scene::createEmpty();
+      auto obj = Object::create(*scene);
+      auto* raw = obj.get();
+      scene->addObject(std::move(obj));
+      const auto subscription = scene->subscribe<CameraComponent>();
+
+      raw->addComponent<CameraComponent>();
+      QCOMPARE(scene->drainChanges<CameraComponent>(subscription).added,
+               std::vector<QUuid>{raw->id()});
+
+      raw->getComponent<CameraComponent>().dirty();
+      QCOMPARE(scene->drainChanges<CameraComponent>(subscription).modified,
+               std::vector<QUuid>{raw->id()});
+
+      raw->removeComponent<CameraComponent>();
+      QCOMPARE(scene->drainChanges<CameraComponent>(subscription).removed,
+               std::vector<QUuid>{raw->id()});
+      scene->unsubscribe<CameraComponent>(subscription);
+   }
+
+private:
+   using CameraQuery = ComponentsQuery<CameraComponent, TransformComponent>;
+
+   static std::vector<Object*> sorted(std::vector<Object*> objects) {
+      std::ranges::sort(objects);
+      return objects;
+   }
+
+   static std::vector<Object*> viewed(Scene& scene) {
+      std::vector<Object*> objects;
+      for (auto [camera, transform]: scene.view<CameraComponent, TransformComponent>()) {
+         objects.push_back(&camera.parent());
+      }
+      return sorted(std::move(objects));
+   }
+
+   static std::vector<Object*> queried(const CameraQuery& query) {
+      std::vector<Object*> objects;
+      for (const auto& entry: query.entries()) objects.push_back(entry.object);
+      return sorted(std::move(objects));
+   }
+};
+
+QTEST_GUILESS_MAIN(ComponentsRegistryTest)
+#include "ComponentsRegistryTest.moc"
@@ -0,0 +1,155 @@
+#include "Common/JobSystem.h"
+#include <QTest>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+
+/// Chunking of parallelFor, nested batches and exceptions thrown by jobs
+class JobSystemTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void parallelForVisitsEveryIndexOnce_data() {
+      QTest::addColumn<int>("workers");
+      QTest::addColumn<int>("count");
+      QTest::addColumn<int>("grain");
+      QTest::newRow("empty") << 3 << 0 << 4;
+      QTest::newRow("single chunk") << 3 << 4 << 4;
+      QTest::newRow("uneven tail") << 3 << 1001 << 16;
+      QTest::newRow("grain zero") << 3 << 50 << 0;
+      QTest::newRow("no workers") << 0 << 1000 << 7;
+   }
+
+   void parallelForVisitsEveryIndexOnce() {
+      QFETCH(int, workers);
+      QFETCH(int, count);
+      QFETCH(int, grain);
+
+      JobSystem jobs(workers);
+      std::vector<std::atomic<int> > visits(count);
+      // without workers everything is one chunk on the calling thread
+      const auto largest = workers ? size_t(std::max(grain, 1)) : size_t(count);
+      // chunks run on the workers, so they are checked here afterwards
+      std::atomic<bool> chunksValid = true;
+      jobs.parallelFor(count, grain, [&](size_t begin, size_t end) {
+         if (begin >= end || end > size_t(count) || end - begin > largest) chunksValid = false;
+         for (auto i = begin; i < end; ++i) visits[i]++;
+      });
+      QVERIFY(chunksValid);
+      for (const auto& visit: visits) QCOMPARE(visit.load(), 1);
+   }
+
+   void nestedBatchesFinish() {
+      JobSystem jobs(3);
+      std::atomic<int> sum = 0;
+      jobs.parallelFor(16, 1, [&](size_t, size_t) {
+         // waiting inside a job runs other jobs meanwhile instead of blocking the worker
+         jobs.parallelFor(64, 4, [&](size_t begin, size_t end) { sum += int(end - begin); });
+      });
+      QCOMPARE(sum.load(), 16 * 64);
+   }
+
+   void submittedJobsAreWaitedFor() {
+      JobSystem jobs(2);
+      JobCounter counter;
+      std::atomic<int> done = 0;
+      for (int i = 0; i < 100; ++i) jobs.submit([&] { done++; }, counter);
+      jobs.wait(counter);
+      QCOMPARE(done.load(), 100);
+      QCOMPARE(counter.pending.load(), size_t(0));
+   }
+
+   void exceptionsReachTheWaitingThread() {
+      JobSystem jobs(3);
+      std::atomic<int> done = 0;
+      bool thrown = false;
+      try {
+         jobs.parallelFor(100, 1, [&](size_t begin, size_t) {
+            if (begin % 10 == 3) throw std::runtime_error("job failed");
+            done++;
+         });
+      } catch (const std::runtime_error&) {
+         thrown = true;
+      }
+      QVERIFY(thrown);
+      // the other jobs of the batch still ran
+      QCOMPARE(done.load(), 90);
+
+      // the pool keeps working afterwards
+      std::atomic<int> after = 0;
+      jobs.parallelFor(100, 1, [&](size_t, size_t) { after++; });
+      QCOMPARE(after.load(), 100);
+   }
+
+   void exceptionOfTheCallingThreadWaitsForTheRest() {
+      JobSystem jobs(3);
+      std::atomic<int> done = 0;
+      bool thrown = false;
+      try {
+         jobs.parallelFor(64, 1, [&](size_t begin, size_t) {
+            // the first chunk runs on the calling thread
+            if (begin == 0) throw std::logic_error("caller failed");
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            done++;
+         });
+      } catch (const std::logic_error&) {
+         thrown = true;
+      }
+      QVERIFY(thrown);
+      QCOMPARE(done.load(), 63);
+   }
+
+   void threadsOutsideThePoolOnlyRunTheirOwnJobs() {
+      JobSystem jobs(1);
+      // both threads share the queue of non-pool threads and wait at the same time
+      auto batch = [&jobs](std::set<std::thread::id>& runners) {
+         std::mutex mutex;
+         jobs.parallelFor(200, 1, [&](size_t, size_t) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            std::lock_guard lock(mutex);
+            runners.insert(std::this_thread::get_id());
+         });
+      };
+      std::set<std::thread::id> firstRunners, secondRunners;
+      std::thread first(batch, std::ref(firstRunners)), second(batch, std::ref(secondRunners));
+      const auto firstId = first.get_id(), secondId = second.get_id();
+      first.join();
+      second.join();
+      QVERIFY(firstRunners.contains(firstId));
+      QVERIFY(!firstRunners.contains(secondId));
+      QVERIFY(secondRunners.contains(secondId));
+      QVERIFY(!secondRunners.contains(firstId));
+   }
+
+   void workersOfOtherPoolsAreOutsideThreads() {
+      JobSystem first(1), second(1);
+      // a batch of the calling thread which is still queued while the worker of first waits
+      JobCounter queued;
+      std::mutex mutex;
+      std::set<std::thread::id> queuedRunners;
+      for (int i = 0; i < 100; ++i) {
+         second.submit([&] {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            std::lock_guard lock(mutex);
+            queuedRunners.insert(std::this_thread::get_id());
+         }, queued);
+      }
+
+      JobCounter outer;
+      std::thread::id worker;
+      first.submit([&] {
+         worker = std::this_thread::get_id();
+         second.parallelFor(64, 1, [](size_t, size_t) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+         });
+      }, outer);
+      // not waited for with first.wait, which could run the job on this thread
+      while (outer.pending.load() != 0) std::this_thread::yield();
+      first.wait(outer);
+      second.wait(queued);
+      QVERIFY(!queuedRunners.contains(worker));
+   }
+};
+
+QTEST_GUILESS_MAIN(JobSystemTest)
+#include "JobSystemTest.moc"
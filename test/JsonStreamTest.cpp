@@ -0,0 +1,196 @@
+#include "Model/Serialization/JsonStream.h"
+#include <QBuffer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+#include <limits>
+
+/// Streamed json has to read and write the same documents as QJsonDocument
+class JsonStreamTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void writerMatchesQJsonDocument() {
+      const auto document = sample();
+      const auto written = write(document);
+      QJsonParseError error;
+      const auto parsed = QJsonDocument::fromJson(written, &error);
+      QCOMPARE(error.error, QJsonParseError::NoError);
+      QCOMPARE(parsed.object(), document);
+
+      // the same document written as one value
+      QByteArray whole;
+      QBuffer buffer(&whole);
+      buffer.open(QIODevice::WriteOnly);
+      JsonStreamWriter writer(buffer);
+      writer.value(document);
+      QVERIFY(writer.ok());
+      QCOMPARE(QJsonDocument::fromJson(whole).object(), document);
+   }
+
+   void nonFiniteNumbersAreWrittenAsNull() {
+      const QJsonArray numbers{std::numeric_limits<double>::quiet_NaN(),
+                               std::numeric_limits<double>::infinity(),
+                               -std::numeric_limits<double>::infinity(), 1.5};
+      QCOMPARE(JsonStreamWriter::encode(numbers),
+               QJsonDocument(numbers).toJson(QJsonDocument::Compact));
+      for (const auto& number: numbers) {
+         // QJsonDocument only writes containers, the brackets are cut off
+         const auto expected = QJsonDocument(QJsonArray{number}).toJson(QJsonDocument::Compact);
+         QCOMPARE(JsonStreamWriter::encode(number), expected.mid(1).chopped(1));
+      }
+
+      QJsonObject object{{"nan", std::numeric_limits<double>::quiet_NaN()}};
+      const auto parsed = QJsonDocument::fromJson(write(object)).object();
+      QVERIFY(parsed["nan"].isNull());
+   }
+
+   void readerMatchesQJsonDocument_data() {
+      QTest::addColumn<bool>("indented");
+      QTest::newRow("compact") << false;
+      QTest::newRow("indented") << true;
+   }
+
+   void readerMatchesQJsonDocument() {
+      QFETCH(bool, indented);
+
+      // large enough to span many reads and to drop consumed data in between
+      const auto document = sample();
+      auto data = QJsonDocument(document).toJson(indented ? QJsonDocument::Indented
+                                                          : QJsonDocument::Compact);
+      QVERIFY(data.size() > (1 << 20));
+
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::ReadOnly);
+      JsonStreamReader reader(buffer);
+      QCOMPARE(readLike(reader, document), QJsonValue(document));
+      QVERIFY(!reader.hasError());
+   }
+
+   void readerSkipsAndReadsRaw() {
+      QByteArray data =
+            R"({"skipped": {"a": [1, {"b": "}]"}]}, "raw": [1, 2.5, "x"], "last": true})";
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::ReadOnly);
+      JsonStreamReader reader(buffer);
+
+      QString key;
+      QVERIFY(reader.enterObject());
+      QVERIFY(reader.nextKey(key));
+      QCOMPARE(key, QString("skipped"));
+      reader.skipValue();
+      QVERIFY(reader.nextKey(key));
+      QCOMPARE(key, QString("raw"));
+      bool ok = false;
+      QCOMPARE(JsonStreamReader::parse(reader.readRaw(), &ok), QJsonValue(QJsonArray{1, 2.5, "x"}));
+      QVERIFY(ok);
+      QVERIFY(reader.nextKey(key));
+      QCOMPARE(reader.readValue(), QJsonValue(true));
+      QVERIFY(!reader.nextKey(key));
+      QVERIFY(!reader.hasError());
+   }
+
+   void readerReportsBrokenData_data() {
+      QTest::addColumn<QByteArray>("data");
+      QTest::newRow("empty") << QByteArray();
+      QTest::newRow("truncated") << QByteArray(R"({"a": [1, 2)");
+      QTest::newRow("missing comma") << QByteArray(R"({"a": 1 "b": 2})");
+      QTest::newRow("double comma") << QByteArray(R"({"a": [1,, 2]})");
+      QTest::newRow("missing colon") << QByteArray(R"({"a" 1})");
+      QTest::newRow("bad scalar") << QByteArray(R"({"a": tru})");
+      QTest::newRow("no object") << QByteArray(R"([1, 2])");
+   }
+
+   void readerReportsBrokenData() {
+      QFETCH(QByteArray, data);
+
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::ReadOnly);
+      JsonStreamReader reader(buffer);
+      if (reader.enterObject()) {
+         QString key;
+         while (reader.nextKey(key)) reader.readValue();
+      }
+      QVERIFY(reader.hasError());
+   }
+
+private:
+   /// Every kind of value with strings that need escaping, plus enough elements to be large
+   static QJsonObject sample() {
+      QJsonArray elements;
+      for (int i = 0; i < 20000; ++i) {
+         elements.append(QJsonObject{
+            {"name", QString("object %1").arg(i)},
+            {"value", i + 0.25},
+            {"tags", QJsonArray{"a", i % 2 == 0, QJsonValue::Null}},
+         });
+      }
+
+      return {
+         {"string", "quote \" backslash \\ newline \n tab \t control \x01 unicode é中"},
+         {"integers", QJsonArray{0, -1, 42, 2147483647}},
+         {"doubles", QJsonArray{0.1, -2.5e-8, 1e300, 3.14159}},
+         {"bools", QJsonArray{true, false}},
+         {"null", QJsonValue::Null},
+         {"empty object", QJsonObject()},
+         {"empty array", QJsonArray()},
+         {"nested", QJsonObject{{"array", QJsonArray{QJsonArray{1, 2}, QJsonObject{{"}", "]"}}}}}}},
+         {"elements", elements},
+      };
+   }
+
+   /// Writes containers token by token, so the writer has to place all separators itself
+   static void writeTokens(JsonStreamWriter& writer, const QJsonValue& value) {
+      if (value.isObject()) {
+         writer.beginObject();
+         const auto object = value.toObject();
+         for (auto it = object.begin(); it != object.end(); ++it) {
+            writer.key(it.key());
+            writeTokens(writer, it.value());
+         }
+         writer.endObject();
+      } else if (value.isArray()) {
+         writer.beginArray();
+         for (const auto& element: value.toArray()) writeTokens(writer, element);
+         writer.endArray();
+      } else {
+         writer.value(value);
+      }
+   }
+
+   static QByteArray write(const QJsonObject& object) {
+      QByteArray data;
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::WriteOnly);
+      JsonStreamWriter writer(buffer);
+      writeTokens(writer, object);
+      return data;
+   }
+
+   /// Walks the data with the reader the way shape is built, scalars are read as values
+   static QJsonValue readLike(JsonStreamReader& reader, const QJsonValue& shape) {
+      QString key;
+      if (shape.isObject()) {
+         if (!reader.enterObject()) return {};
+         QJsonObject object;
+         while (reader.nextKey(key)) object[key] = readLike(reader, shape.toObject()[key]);
+         return object;
+      }
+      if (shape.isArray() && !shape.toArray().isEmpty()) {
+         if (!reader.enterArray()) return {};
+         QJsonArray array;
+         const auto elements = shape.toArray();
+         while (reader.nextElement()) {
+            // elements which the shape doesn't have are read as whole values
+            array.append(array.size() < elements.size() ? readLike(reader, elements[array.size()])
+                                                        : reader.readValue());
+         }
+         return array;
+      }
+      return reader.readValue();
+   }
+};
+
+QTEST_GUILESS_MAIN(JsonStreamTest)
+#include "JsonStreamTest.moc"
@@ -0,0 +1,100 @@
+#include "Common/Lz4.h"
+#include <QTest>
+#include <random>
+
+/// The block codec round trips any size and rejects data which would read or write out of bounds
+class Lz4Test : public QObject {
+   Q_OBJECT
+
+private slots:
+   void roundTrips_data() {
+      QTest::addColumn<int>("size");
+      QTest::addColumn<bool>("repetitive");
+      QTest::newRow("empty") << 0 << true;
+      QTest::newRow("one byte") << 1 << true;
+      // too short for any match, everything is literals
+      QTest::newRow("match limit") << 12 << true;
+      QTest::newRow("block") << 65536 << true;
+      QTest::newRow("random block") << 65536 << false;
+      // matches can't reach further back than 64 KiB
+      QTest::newRow("beyond the window") << 300000 << true;
+   }
+
+   void roundTrips() {
+      QFETCH(int, size);
+      QFETCH(bool, repetitive);
+
+      const auto data = sample(size, repetitive);
+      std::vector<uint8_t> compressed(Lz4::bound(data.size()));
+      const auto compressedSize = Lz4::compress(data.data(), data.size(), compressed.data(),
+                                                compressed.size());
+      QVERIFY(compressedSize != 0);
+      if (repetitive && size >= 65536) QVERIFY(compressedSize < data.size() / 10);
+
+      std::vector<uint8_t> decompressed(data.size());
+      QVERIFY(Lz4::decompress(compressed.data(), compressedSize, decompressed.data(),
+                              decompressed.size()));
+      QVERIFY(decompressed == data);
+
+      // the size has to match exactly
+      std::vector<uint8_t> larger(data.size() + 1);
+      QVERIFY(!Lz4::decompress(compressed.data(), compressedSize, larger.data(), larger.size()));
+      if (size > 0) {
+         QVERIFY(!Lz4::decompress(compressed.data(), compressedSize, decompressed.data(),
+                                  decompressed.size() - 1));
+         QVERIFY(!Lz4::decompress(compressed.data(), compressedSize - 1, decompressed.data(),
+                                  decompressed.size()));
+      }
+   }
+
+   void incompressibleDataDoesntFitIntoLess() {
+      // callers store such blocks as they are
+      const auto data = sample(65536, false);
+      std::vector<uint8_t> compressed(data.size() - 1);
+      QCOMPARE(Lz4::compress(data.data(), data.size(), compressed.data(), compressed.size()),
+               size_t(0));
+   }
+
+   void corruptDataIsRejected_data() {
+      QTest::addColumn<QByteArray>("data");
+      QTest::addColumn<int>("size");
+      QTest::addColumn<bool>("valid");
+      // one literal, a match of 4 repeating it and an empty last sequence
+      QTest::newRow("valid") << QByteArray("\x10" "a" "\x01\x00" "\x00", 5) << 5 << true;
+      QTest::newRow("empty") << QByteArray() << 0 << false;
+      QTest::newRow("offset zero") << QByteArray("\x10" "a" "\x00\x00" "\x00", 5) << 5 << false;
+      QTest::newRow("offset before the start")
+            << QByteArray("\x10" "a" "\x02\x00" "\x00", 5) << 5 << false;
+      QTest::newRow("match past the end")
+            << QByteArray("\x10" "a" "\x01\x00" "\x00", 5) << 4 << false;
+      QTest::newRow("literals past the input") << QByteArray("\x50" "a", 2) << 5 << false;
+      QTest::newRow("literals past the output") << QByteArray("\x30" "abc", 4) << 2 << false;
+      QTest::newRow("unterminated length") << QByteArray("\xf0\xff", 2) << 300 << false;
+      QTest::newRow("truncated offset") << QByteArray("\x10" "a" "\x01", 3) << 5 << false;
+      QTest::newRow("missing last sequence") << QByteArray("\x10" "a" "\x01\x00", 4) << 5 << false;
+   }
+
+   void corruptDataIsRejected() {
+      QFETCH(QByteArray, data);
+      QFETCH(int, size);
+      QFETCH(bool, valid);
+
+      std::vector<uint8_t> decompressed(size);
+      QCOMPARE(Lz4::decompress(data.constData(), data.size(), decompressed.data(), size), valid);
+      if (valid) QVERIFY(decompressed == std::vector<uint8_t>(size, 'a'));
+   }
+
+private:
+   /// Repetitive data is runs of bytes which recur every 16 KiB, the rest is random
+   static std::vector<uint8_t> sample(int size, bool repetitive) {
+      std::mt19937 random(5);
+      std::vector<uint8_t> data(size);
+      for (int i = 0; i < size; ++i) {
+         data[i] = repetitive ? uint8_t((i / 64) * 31) : uint8_t(random());
+      }
+      return data;
+   }
+};
+
+QTEST_GUILESS_MAIN(Lz4Test)
+#include "Lz4Test.moc"
@@ -0,0 +1,118 @@
+#include "Model/Serialization/PackedStream.h"
+#include <QTest>
+#include <limits>
+#include <random>
+
+/// Packed mesh streams round trip and reject json whose layout or size doesn't match
+class PackedStreamTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void roundTrips_data() {
+      QTest::addColumn<int>("count");
+      QTest::addColumn<bool>("repetitive");
+      QTest::addColumn<bool>("compressed");
+      QTest::newRow("empty") << 0 << true << false;
+      QTest::newRow("small") << 10 << true << false;
+      // payloads above the threshold are compressed unless that doesn't make them smaller
+      QTest::newRow("compressible") << 4000 << true << true;
+      QTest::newRow("incompressible") << 4000 << false << false;
+   }
+
+   void roundTrips() {
+      QFETCH(int, count);
+      QFETCH(bool, repetitive);
+      QFETCH(bool, compressed);
+
+      std::mt19937 random(7);
+      std::uniform_real_distribution<float> value(-1000, 1000);
+      std::vector<QVector3D> vertices;
+      std::vector<QVector2D> uvs;
+      std::vector<uint16_t> indices;
+      for (int i = 0; i < count; ++i) {
+         const float x = repetitive ? float(i % 3) : value(random);
+         vertices.emplace_back(x, value(random), value(random));
+         uvs.emplace_back(x, repetitive ? 0.5f : value(random));
+         indices.push_back(uint16_t(repetitive ? i % 3 : random()));
+      }
+
+      const auto vertexJson = PackedStream::pack(MeshStream<QVector3D>(vertices));
+      QCOMPARE(vertexJson["count"].toInteger(), qint64(count));
+      QCOMPARE(vertexJson["stride"].toInteger(), qint64(sizeof(QVector3D)));
+      QCOMPARE(roundTrip(vertices), true);
+      QCOMPARE(roundTrip(uvs), true);
+      QCOMPARE(roundTrip(indices), true);
+
+      // random floats still share their exponents, only random indices are truly incompressible
+      const auto indexJson = PackedStream::pack(MeshStream<uint16_t>(indices));
+      QCOMPARE(indexJson["compressed"].toBool(), compressed);
+   }
+
+   void mismatchingJsonIsRejected_data() {
+      QTest::addColumn<QString>("key");
+      QTest::addColumn<QJsonValue>("value");
+      QTest::newRow("type") << QString("type") << QJsonValue("uint16");
+      QTest::newRow("components") << QString("components") << QJsonValue(2);
+      QTest::newRow("stride") << QString("stride") << QJsonValue(16);
+      QTest::newRow("count too large") << QString("count") << QJsonValue(11);
+      QTest::newRow("count too small") << QString("count") << QJsonValue(9);
+      QTest::newRow("negative count") << QString("count") << QJsonValue(-1);
+      QTest::newRow("overflowing count")
+            << QString("count") << QJsonValue(std::numeric_limits<qint64>::max() / 4);
+      QTest::newRow("missing data") << QString("data") << QJsonValue();
+      QTest::newRow("broken compression") << QString("compressed") << QJsonValue(true);
+   }
+
+   void mismatchingJsonIsRejected() {
+      QFETCH(QString, key);
+      QFETCH(QJsonValue, value);
+
+      std::vector<QVector3D> vertices(10, QVector3D(1, 2, 3));
+      auto json = PackedStream::pack(MeshStream<QVector3D>(vertices));
+      json[key] = value;
+
+      // a rejected stream keeps what it held before
+      MeshStream<QVector3D> stream{QVector3D(4, 5, 6)};
+      QVERIFY(!PackedStream::unpack(json, stream));
+      QVERIFY(stream == std::vector<QVector3D>{QVector3D(4, 5, 6)});
+   }
+
+   void largePayloadsAreDeferred() {
+      std::vector<QVector3D> vertices;
+      for (int i = 0; i < 1000; ++i) vertices.emplace_back(float(i), 0, 0);
+      const auto json = PackedStream::pack(MeshStream<QVector3D>(vertices));
+
+      MeshStream<QVector3D> stream;
+      QVERIFY(PackedStream::defer(json, stream));
+      QVERIFY(!stream.isLoaded());
+      QCOMPARE(stream.size(), vertices.size());
+      QVERIFY(stream == vertices);
+      QVERIFY(stream.isLoaded());
+
+      // small payloads are decoded right away
+      const auto small = PackedStream::pack(MeshStream<QVector3D>{QVector3D(1, 2, 3)});
+      QVERIFY(PackedStream::defer(small, stream));
+      QVERIFY(stream.isLoaded());
+
+      // the layout is checked up front, a broken payload only shows once it is loaded
+      auto wrongType = json;
+      wrongType["type"] = "uint16";
+      QVERIFY(!PackedStream::defer(wrongType, stream));
+      auto broken = json;
+      broken["data"] = QString::fromLatin1(QByteArray(64, 'A').toBase64());
+      QVERIFY(PackedStream::defer(broken, stream));
+      stream.load();
+      QVERIFY(stream.empty());
+   }
+
+private:
+   template<typename T>
+   static bool roundTrip(const std::vector<T>& elements) {
+      MeshStream<T> stream;
+      return PackedStream::unpack(PackedStream::pack(MeshStream<T>(elements)), stream) &&
+             stream == elements;
+   }
+};
+
+QTEST_GUILESS_MAIN(PackedStreamTest)
+#include "PackedStreamTest.moc"
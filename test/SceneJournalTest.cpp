@@ -0,0 +1,192 @@
+#include "Model/Components/CameraComponent.h"
+#include "Model/Hierarchy/Object.h"
+#include "Model/Hierarchy/Scene.h"
+#include "Model/Serialization/SceneFile.h"
+#include "Model/Serialization/SceneJournal.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QTest>
+#include <map>
+
+/// Incremental saves have to load back into the same scene, whether replayed or compacted
+class SceneJournalTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void init() {
+      QVERIFY(m_dir.isValid());
+      m_path = m_dir.filePath("test.scene");
+      m_scene = Scene::createEmpty();
+      for (const auto* name: {"a", "b", "c", "d"}) {
+         auto obj = Object::create(*m_scene);
+         obj->setName(name);
+         m_scene->addObject(std::move(obj));
+      }
+      m_scene->addChild(object("a"), object("d"));
+      object("b").addComponent<CameraComponent>().fov = 60;
+   }
+
+   void cleanup() {
+      m_scene.reset();
+      SceneJournal::discard(m_path);
+      QFile::remove(m_path);
+   }
+
+   void firstSaveWritesTheBase() {
+      SceneJournal journal(*m_scene, m_path);
+      QVERIFY(!journal.appends());
+      QVERIFY(journal.hasChanges());
+      QVERIFY(journal.save());
+      QVERIFY(journal.appends());
+      QVERIFY(!journal.hasChanges());
+      QVERIFY(!QFile::exists(SceneJournal::journalPath(m_path)));
+
+      // nothing changed, nothing is appended
+      QVERIFY(journal.save());
+      QVERIFY(!QFile::exists(SceneJournal::journalPath(m_path)));
+      QVERIFY(loadedState() == state(*m_scene));
+   }
+
+   void changesAreAppendedAndReplayed() {
+      SceneJournal journal(*m_scene, m_path);
+      QVERIFY(journal.save());
+      const auto baseSize = QFileInfo(m_path).size();
+
+      change(1);
+      QVERIFY(journal.hasChanges());
+      QVERIFY(journal.save());
+      QVERIFY(!journal.hasChanges());
+      const auto journalSize = QFileInfo(SceneJournal::journalPath(m_path)).size();
+      QVERIFY(journalSize > 0);
+      QCOMPARE(QFileInfo(m_path).size(), baseSize);
+      QVERIFY(loadedState() == state(*m_scene));
+
+      // later saves only append what changed since the one before
+      change(2);
+      QVERIFY(journal.save());
+      QVERIFY(QFileInfo(SceneJournal::journalPath(m_path)).size() > journalSize);
+      QVERIFY(loadedState() == state(*m_scene));
+   }
+
+   void brokenLastLineIsIgnored() {
+      SceneJournal journal(*m_scene, m_path);
+      QVERIFY(journal.save());
+      change(1);
+      QVERIFY(journal.save());
+      const auto expected = state(*m_scene);
+
+      // a crash while appending leaves half a line behind
+      QFile file(SceneJournal::journalPath(m_path));
+      QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+      file.write(R"({"object": {"id": ")");
+      file.close();
+      QVERIFY(loadedState() == expected);
+   }
+
+   void compactionMergesTheJournalIntoTheBase() {
+      SceneJournal journal(*m_scene, m_path);
+      QVERIFY(journal.save());
+      change(1);
+      QVERIFY(journal.save());
+      change(2);
+      QVERIFY(journal.save());
+
+      QVERIFY(startCompaction());
+      QVERIFY(SceneJournal::compact(m_path));
+      QVERIFY(!QFile::exists(SceneJournal::compactingPath(m_path)));
+      QVERIFY(!QFile::exists(SceneJournal::journalPath(m_path)));
+
+      QFile base(m_path);
+      QVERIFY(base.open(QIODevice::ReadOnly));
+      QJsonParseError error;
+      QJsonDocument::fromJson(base.readAll(), &error);
+      QCOMPARE(error.error, QJsonParseError::NoError);
+      QVERIFY(loadedState() == state(*m_scene));
+   }
+
+   void savesDuringCompactionAreKept() {
+      SceneJournal journal(*m_scene, m_path);
+      QVERIFY(journal.save());
+      change(1);
+      QVERIFY(journal.save());
+      QVERIFY(startCompaction());
+
+      // changes saved while the old journal is merged go to a new one, which is replayed after it
+      change(2);
+      QVERIFY(journal.save());
+      QVERIFY(loadedState() == state(*m_scene));
+      QVERIFY(SceneJournal::compact(m_path));
+      QVERIFY(QFile::exists(SceneJournal::journalPath(m_path)));
+      QVERIFY(loadedState() == state(*m_scene));
+   }
+
+   void loadedScenesAppendToTheirBase() {
+      {
+         SceneJournal journal(*m_scene, m_path);
+         QVERIFY(journal.save());
+      }
+
+      auto loaded = SceneFile::load(m_path);
+      QVERIFY(loaded);
+      SceneJournal journal(*loaded, m_path, nullptr, true);
+      QVERIFY(journal.appends());
+      auto obj = Object::create(*loaded);
+      obj->setName("e");
+      loaded->addObject(std::move(obj));
+      QVERIFY(journal.save());
+      QVERIFY(QFile::exists(SceneJournal::journalPath(m_path)));
+      QVERIFY(loadedState() == state(*loaded));
+   }
+
+private:
+   Object& object(const QString& name) { return **m_scene->findObject(name); }
+
+   /// What a save does once the journal grows too large, the merge is then run by the test
+   bool startCompaction() const {
+      return QFile::rename(SceneJournal::journalPath(m_path), SceneJournal::compactingPath(m_path));
+   }
+
+   /// Renames, component edits, new and removed objects and reparenting
+   void change(int step) {
+      if (step == 1) {
+         object("a").setName("renamed");
+         auto& camera = object("b").getComponent<CameraComponent>();
+         camera.fov = 75;
+         camera.dirty();
+         auto obj = Object::create(*m_scene);
+         obj->setName("e");
+         auto* raw = obj.get();
+         m_scene->addObject(std::move(obj));
+         m_scene->addChild(object("renamed"), *raw);
+         m_scene->removeObject(object("c"));
+      } else {
+         m_scene->removeChild(object("renamed"), object("d"));
+         m_scene->placeAfter(object("d"), nullptr);
+         object("e").addComponent<CameraComponent>().fov = 30;
+         m_scene->removeObject(object("b"));
+      }
+   }
+
+   /// Everything that is saved about every object, keyed by its id
+   static std::map<QString, QJsonObject> state(const Scene& scene) {
+      std::map<QString, QJsonObject> objects;
+      for (const auto* obj: scene.objects()) {
+         objects[obj->id().toString()] = scene.objectDelta(*obj);
+      }
+      return objects;
+   }
+
+   std::map<QString, QJsonObject> loadedState() const {
+      auto loaded = SceneFile::load(m_path);
+      return loaded ? state(*loaded) : std::map<QString, QJsonObject>();
+   }
+
+   QTemporaryDir m_dir;
+   QString m_path;
+   uptr<Scene> m_scene;
+};
+
+QTEST_GUILESS_MAIN(SceneJournalTest)
+#include "SceneJournalTest.moc"
@@ -0,0 +1,112 @@
+#include "Model/Hierarchy/Object.h"
+#include "Model/Hierarchy/Scene.h"
+#include <QTest>
+
+/// Sparse sibling order keys: moves between neighbours, renumbering and per-parent orders
+class SceneOrderTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void addedObjectsAreAppended() {
+      auto scene = Scene::createEmpty();
+      const auto objects = addObjects(*scene, 3);
+      QCOMPARE(scene->orderedChildrenOf(nullptr), objects);
+      QVERIFY(objects[0]->order() < objects[1]->order());
+      QVERIFY(objects[1]->order() < objects[2]->order());
+   }
+
+   void placeAfterOnlyChangesTheMovedObject() {
+      auto scene = Scene::createEmpty();
+      const auto objects = addObjects(*scene, 3);
+      auto *a = objects[0], *b = objects[1], *c = objects[2];
+      const auto orderA = a->order(), orderB = b->order();
+      const auto subscription = scene->subscribeObjects();
+
+      scene->placeAfter(*c, a);
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{a, c, b}));
+      QCOMPARE(a->order(), orderA);
+      QCOMPARE(b->order(), orderB);
+      QCOMPARE(scene->drainObjectChanges(subscription).modified, std::vector<QUuid>{c->id()});
+
+      scene->placeAfter(*b, nullptr);
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{b, a, c}));
+      scene->placeAfter(*b, c);
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{a, c, b}));
+
+      // placing an object after itself changes nothing
+      scene->placeAfter(*c, c);
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{a, c, b}));
+      scene->unsubscribeObjects(subscription);
+   }
+
+   void exhaustedGapsAreRenumbered() {
+      auto scene = Scene::createEmpty();
+      const auto objects = addObjects(*scene, 2);
+      auto *first = objects[0], *last = objects[1];
+      const auto orderLast = last->order();
+
+      // every insert halves the gap after first, so it runs out long before 100 objects
+      std::vector<Object*> inserted;
+      for (auto* obj: addObjects(*scene, 100)) {
+         scene->placeAfter(*obj, first);
+         inserted.insert(inserted.begin(), obj);
+      }
+      QVERIFY(last->order() != orderLast);
+
+      std::vector<Object*> expected{first};
+      expected.insert(expected.end(), inserted.begin(), inserted.end());
+      expected.push_back(last);
+      const auto ordered = scene->orderedChildrenOf(nullptr);
+      QCOMPARE(ordered, expected);
+      for (size_t i = 1; i < ordered.size(); ++i) {
+         QVERIFY(ordered[i - 1]->order() < ordered[i]->order());
+      }
+   }
+
+   void setOrderMovesAmongSiblings() {
+      auto scene = Scene::createEmpty();
+      const auto objects = addObjects(*scene, 3);
+      auto *a = objects[0], *b = objects[1], *c = objects[2];
+
+      c->setOrder(1);
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{c, a, b}));
+
+      // a key which is already taken appends the object instead
+      a->setOrder(b->order());
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{c, b, a}));
+   }
+
+   void childrenAreOrderedPerParent() {
+      auto scene = Scene::createEmpty();
+      const auto objects = addObjects(*scene, 4);
+      auto *parent = objects[0], *a = objects[1], *b = objects[2], *root = objects[3];
+
+      scene->addChild(*parent, *b);
+      scene->addChild(*parent, *a);
+      QCOMPARE(scene->orderedChildrenOf(parent), (std::vector<Object*>{b, a}));
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{parent, root}));
+
+      scene->placeAfter(*a, nullptr);
+      QCOMPARE(scene->orderedChildrenOf(parent), (std::vector<Object*>{a, b}));
+
+      // a child which leaves its parent goes to the end of the roots
+      scene->removeChild(*parent, *a);
+      QCOMPARE(scene->orderedChildrenOf(parent), std::vector<Object*>{b});
+      QCOMPARE(scene->orderedChildrenOf(nullptr), (std::vector<Object*>{parent, root, a}));
+      QVERIFY(scene->orderedChildrenOf(b).empty());
+   }
+
+private:
+   static std::vector<Object*> addObjects(Scene& scene, size_t count) {
+      std::vector<Object*> objects;
+      for (size_t i = 0; i < count; ++i) {
+         auto obj = Object::create(scene);
+         objects.push_back(obj.get());
+         scene.addObject(std::move(obj));
+      }
+      return objects;
+   }
+};
+
+QTEST_GUILESS_MAIN(SceneOrderTest)
+#include "SceneOrderTest.moc"
@@ -0,0 +1,128 @@
+#include "Model/Components/TransformComponent.h"
+#include "Model/Hierarchy/Object.h"
+#include "Model/Hierarchy/Scene.h"
+#include <QTest>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+/// Cached world matrices follow edits of any ancestor, moves between parents and transforms
+/// which are removed or added in the middle of the hierarchy
+class SceneTransformTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void init() {
+      // a -> b -> c, every one of them one unit further along x than its parent
+      m_scene = Scene::createEmpty();
+      for (auto*& obj: m_objects) {
+         auto created = Object::create(*m_scene);
+         obj = created.get();
+         obj->getComponent<TransformComponent>().position = QVector3D(1, 0, 0);
+         m_scene->addObject(std::move(created));
+      }
+      m_scene->addChild(*m_objects[0], *m_objects[1]);
+      m_scene->addChild(*m_objects[1], *m_objects[2]);
+      m_scene->updateTransforms();
+   }
+
+   void cleanup() { m_scene.reset(); }
+
+   void parentEditsReachGrandchildren() {
+      QVERIFY(fuzzyEqual(world(2), translation(3, 0, 0)));
+
+      auto& root = transform(0);
+      root.position = QVector3D(10, 0, 0);
+      root.rotation = QQuaternion::fromAxisAndAngle(0, 0, 1, 90);
+      root.dirty();
+      m_scene->updateTransforms();
+      QVERIFY(fuzzyEqual(world(1), translation(10, 1, 0) * rotationZ(90)));
+      QVERIFY(fuzzyEqual(world(2), translation(10, 2, 0) * rotationZ(90)));
+   }
+
+   void reparentingKeepsTheWorldIfAsked() {
+      auto parent = Object::create(*m_scene);
+      auto* d = parent.get();
+      auto& moved = d->getComponent<TransformComponent>();
+      moved.position = QVector3D(0, 5, 0);
+      moved.rotation = QQuaternion::fromAxisAndAngle(0, 0, 1, 90);
+      moved.scale = QVector3D(2, 2, 2);
+      m_scene->addObject(std::move(parent));
+      m_scene->updateTransforms();
+
+      const auto before = world(1), childBefore = world(2);
+      Object* const objs[] = {m_objects[1]};
+      QVERIFY(m_scene->reparent(objs, d, true));
+      QVERIFY(fuzzyEqual(world(1), before));
+      QVERIFY(fuzzyEqual(world(2), childBefore));
+
+      // otherwise the local transform stays and the world one follows the new parent
+      const auto local = transform(1).localMatrix();
+      QVERIFY(m_scene->reparent(objs, m_objects[0], false));
+      QVERIFY(fuzzyEqual(world(1), world(0) * local));
+      QVERIFY(fuzzyEqual(world(2), world(0) * local * translation(1, 0, 0)));
+   }
+
+   void removedParentTransformsLeaveRoots() {
+      // the children of an object without a transform are roots
+      m_objects[1]->removeComponent<TransformComponent>();
+      m_scene->updateTransforms();
+      QVERIFY(fuzzyEqual(world(2), translation(1, 0, 0)));
+
+      m_objects[0]->removeComponent<TransformComponent>();
+      m_scene->updateTransforms();
+      QVERIFY(fuzzyEqual(world(2), translation(1, 0, 0)));
+   }
+
+   void removedRootTransformsReachGrandchildren() {
+      m_objects[0]->removeComponent<TransformComponent>();
+      m_scene->updateTransforms();
+      QVERIFY(fuzzyEqual(world(1), translation(1, 0, 0)));
+      QVERIFY(fuzzyEqual(world(2), translation(2, 0, 0)));
+   }
+
+   void addedParentTransformsApplyToChildren() {
+      m_objects[0]->removeComponent<TransformComponent>();
+      m_scene->updateTransforms();
+
+      auto& added = m_objects[0]->addComponent<TransformComponent>();
+      added.position = QVector3D(0, 0, 7);
+      m_scene->updateTransforms();
+      QVERIFY(fuzzyEqual(world(0), translation(0, 0, 7)));
+      QVERIFY(fuzzyEqual(world(1), translation(1, 0, 7)));
+      QVERIFY(fuzzyEqual(world(2), translation(2, 0, 7)));
+   }
+
+private:
+   TransformComponent& transform(size_t i) {
+      return m_objects[i]->getComponent<TransformComponent>();
+   }
+
+   QMatrix4x4 world(size_t i) { return transform(i).modelMatrix(); }
+
+   static QMatrix4x4 translation(float x, float y, float z) {
+      QMatrix4x4 matrix;
+      matrix.translate(x, y, z);
+      return matrix;
+   }
+
+   static QMatrix4x4 rotationZ(float degrees) {
+      QMatrix4x4 matrix;
+      matrix.rotate(degrees, 0, 0, 1);
+      return matrix;
+   }
+
+   static bool fuzzyEqual(const QMatrix4x4& a, const QMatrix4x4& b) {
+      for (int i = 0; i < 16; ++i) {
+         const auto x = a.constData()[i], y = b.constData()[i];
+         if (std::abs(x - y) > 1e-3f * std::max({1.0f, std::abs(x), std::abs(y)})) return false;
+      }
+      return true;
+   }
+
+   uptr<Scene> m_scene;
+   std::array<Object*, 3> m_objects{};
+};
+
+QTEST_GUILESS_MAIN(SceneTransformTest)
+#include "SceneTransformTest.moc"
@@ -0,0 +1,147 @@
+#include "Model/Math/TransformMath.h"
+#include <QTest>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace TransformMath;
+
+/// Affine inverses and the batched compose and decompose kernels against Qt's general versions
+class TransformMathTest : public QObject {
+   Q_OBJECT
+
+private slots:
+   void composeMatchesQt() {
+      for (size_t i = 0; i < 20; ++i) {
+         const auto trs = randomTrs();
+         QMatrix4x4 expected;
+         expected.translate(trs.position);
+         expected.rotate(trs.rotation);
+         expected.scale(trs.scale);
+         QVERIFY(fuzzyEqual(composeTRS(trs.position, trs.rotation, trs.scale), expected));
+      }
+   }
+
+   void inverseAffineMatchesInverted() {
+      for (size_t i = 0; i < 50; ++i) {
+         const auto trs = randomTrs();
+         const auto matrix = composeTRS(trs.position, trs.rotation, trs.scale);
+         QVERIFY(fuzzyEqual(inverseAffine(matrix), matrix.inverted()));
+         QVERIFY(fuzzyEqual(inverseAffine(matrix) * matrix, QMatrix4x4()));
+      }
+
+      // mirrored and sheared matrices are affine as well
+      QMatrix4x4 mirrored;
+      mirrored.translate(1, 2, 3);
+      mirrored.scale(-2, 1, 0.5f);
+      QVERIFY(fuzzyEqual(inverseAffine(mirrored), mirrored.inverted()));
+      QMatrix4x4 sheared(1, 0.5f, 0, 4, 0, 1, 0.25f, 5, 0, 0, 1, 6, 0, 0, 0, 1);
+      QVERIFY(fuzzyEqual(inverseAffine(sheared), sheared.inverted()));
+   }
+
+   void inverseRigidMatchesInverted() {
+      for (size_t i = 0; i < 50; ++i) {
+         const auto trs = randomTrs();
+         const auto matrix = composeTRS(trs.position, trs.rotation, QVector3D(1, 1, 1));
+         QVERIFY(fuzzyEqual(inverseRigid(matrix), matrix.inverted()));
+      }
+   }
+
+   void decomposeRoundTrips() {
+      for (size_t i = 0; i < 50; ++i) {
+         const auto trs = randomTrs();
+         const auto result = decompose(composeTRS(trs.position, trs.rotation, trs.scale));
+         QVERIFY(fuzzyEqual(result.position, trs.position));
+         QVERIFY(fuzzyEqual(result.scale, trs.scale));
+         QVERIFY(sameRotation(result.rotation, trs.rotation));
+      }
+
+      // rotations by 180 degrees have a negative trace and take the other branch
+      for (const auto axis: {QVector3D(1, 0, 0), QVector3D(0, 1, 0), QVector3D(0, 0, 1)}) {
+         const auto rotation = QQuaternion::fromAxisAndAngle(axis, 180);
+         const auto result = decompose(composeTRS(QVector3D(), rotation, QVector3D(1, 2, 3)));
+         QVERIFY(sameRotation(result.rotation, rotation));
+         QVERIFY(fuzzyEqual(result.scale, QVector3D(1, 2, 3)));
+      }
+   }
+
+   void batchesMatchSingleTransforms_data() {
+      QTest::addColumn<int>("count");
+      // covers the vector kernels as well as every length of the scalar tail
+      for (int count: {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33}) {
+         QTest::newRow(QByteArray::number(count).constData()) << count;
+      }
+   }
+
+   void batchesMatchSingleTransforms() {
+      QFETCH(int, count);
+
+      TrsArrays trs;
+      trs.resize(count);
+      std::vector<Trs> inputs;
+      for (int i = 0; i < count; ++i) {
+         inputs.push_back(randomTrs());
+         trs.set(i, inputs.back().position, inputs.back().rotation, inputs.back().scale);
+      }
+
+      std::vector<QMatrix4x4> matrices(count);
+      std::vector<float> floats(16 * count);
+      composeTRS(trs, matrices.data());
+      composeTRS(trs, floats.data());
+
+      TrsArrays decomposed;
+      decompose(matrices.data(), count, decomposed);
+      QCOMPARE(decomposed.size(), size_t(count));
+
+      for (int i = 0; i < count; ++i) {
+         const auto& input = inputs[i];
+         const auto expected = composeTRS(input.position, input.rotation, input.scale);
+         QVERIFY(fuzzyEqual(matrices[i], expected));
+         QVERIFY(fuzzyEqual(QMatrix4x4(floats.data() + 16 * i).transposed(), expected));
+
+         QVERIFY(fuzzyEqual(QVector3D(decomposed.px[i], decomposed.py[i], decomposed.pz[i]),
+                            input.position));
+         QVERIFY(fuzzyEqual(QVector3D(decomposed.sx[i], decomposed.sy[i], decomposed.sz[i]),
+                            input.scale));
+         const QQuaternion rotation(decomposed.rw[i], decomposed.rx[i], decomposed.ry[i],
+                                    decomposed.rz[i]);
+         QVERIFY(sameRotation(rotation, input.rotation));
+      }
+   }
+
+private:
+   Trs randomTrs() {
+      std::uniform_real_distribution<float> position(-100, 100), scale(0.1f, 10), unit(-1, 1);
+      QQuaternion rotation(unit(m_random), unit(m_random), unit(m_random), unit(m_random));
+      return {
+         QVector3D(position(m_random), position(m_random), position(m_random)),
+         rotation.normalized(),
+         QVector3D(scale(m_random), scale(m_random), scale(m_random)),
+      };
+   }
+
+   static bool fuzzyEqual(float a, float b) {
+      return std::abs(a - b) <= 1e-3f * std::max({1.0f, std::abs(a), std::abs(b)});
+   }
+
+   static bool fuzzyEqual(const QVector3D& a, const QVector3D& b) {
+      return fuzzyEqual(a.x(), b.x()) && fuzzyEqual(a.y(), b.y()) && fuzzyEqual(a.z(), b.z());
+   }
+
+   static bool fuzzyEqual(const QMatrix4x4& a, const QMatrix4x4& b) {
+      for (int i = 0; i < 16; ++i) {
+         if (!fuzzyEqual(a.constData()[i], b.constData()[i])) return false;
+      }
+      return true;
+   }
+
+   /// q and -q are the same rotation
+   static bool sameRotation(const QQuaternion& a, const QQuaternion& b) {
+      return std::abs(std::abs(QQuaternion::dotProduct(a, b)) - 1) < 1e-3f;
+   }
+
+   std::mt19937 m_random{42};
+};
+
+QTEST_GUILESS_MAIN(TransformMathTest)
+#include "TransformMathTest.moc"